@@ -4,15 +4,20 @@
       "target_name": "tree_sitter_runtime_binding",
       "dependencies": ["tree_sitter"],
       "sources": [
+        "src/addon_data.cc",
         "src/binding.cc",
         "src/conversions.cc",
         "src/language.cc",
         "src/logger.cc",
+        "src/mapped_file.cc",
         "src/node.cc",
         "src/parser.cc",
+        "src/parser_pool.cc",
         "src/query.cc",
+        "src/query_match_iterator.cc",
         "src/tree.cc",
         "src/tree_cursor.cc",
+        "src/tree_traversal.cc",
         "src/util.cc",
       ],
       "include_dirs": [
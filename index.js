@@ -10,13 +10,21 @@ try {
 }
 
 const util = require('util')
-const {Query, Parser, NodeMethods, Tree, TreeCursor} = binding;
+const {Query, Parser, ParserPool, NodeMethods, Tree, TreeCursor, TreeTraversal} = binding;
+
+// Environments that share an isolate also share the binding's classes. The
+// first environment to load this module has already wrapped them.
+if (Parser.SyntaxNode) {
+  module.exports = Parser;
+  return;
+}
 
 /*
  * Tree
  */
 
-const {rootNode, edit} = Tree.prototype;
+const {rootNode, edit, editMany, toFlatArrays, releaseNodes} = Tree.prototype;
+const {fromShared} = Tree;
 
 Object.defineProperty(Tree.prototype, 'rootNode', {
   get() {
@@ -36,10 +44,75 @@ Tree.prototype.edit = function(arg) {
   );
 };
 
+Tree.prototype.editMany = function(edits) {
+  if (edits instanceof Uint32Array) {
+    return editMany.call(this, edits);
+  }
+
+  const packed = new Uint32Array(edits.length * 9);
+  for (let i = 0, offset = 0; i < edits.length; i++, offset += 9) {
+    const arg = edits[i];
+    packed[offset] = arg.startPosition.row;
+    packed[offset + 1] = arg.startPosition.column;
+    packed[offset + 2] = arg.oldEndPosition.row;
+    packed[offset + 3] = arg.oldEndPosition.column;
+    packed[offset + 4] = arg.newEndPosition.row;
+    packed[offset + 5] = arg.newEndPosition.column;
+    packed[offset + 6] = arg.startIndex;
+    packed[offset + 7] = arg.oldEndIndex;
+    packed[offset + 8] = arg.newEndIndex;
+  }
+  return editMany.call(this, packed);
+};
+
 Tree.prototype.walk = function() {
   return this.rootNode.walk()
 };
 
+// Drops every SyntaxNode that the tree has handed out, along with its slot
+// in the native node table. The released nodes are detached: they no longer
+// refer to a node of the tree, and asking for a node again gives a new object.
+Tree.prototype.releaseNodes = function() {
+  const nodes = this[nodesSymbol];
+  if (nodes) {
+    for (const node of nodes) node[0] = DETACHED_SLOT;
+    this[nodesSymbol] = [];
+  }
+  releaseNodes.call(this);
+  return this;
+};
+
+Tree.prototype.toFlatArrays = function({namedOnly = false, fields = false} = {}) {
+  return toFlatArrays.call(this, namedOnly, fields);
+};
+
+// Recreates a tree from the result of `tree.share()`, which may come from
+// another thread. The tree's text is available if it was parsed from a file,
+// or if the same input is passed here.
+Tree.fromShared = function(handle, language, input) {
+  const tree = fromShared(handle, language);
+  if (!language.nodeSubclasses) {
+    initializeLanguageNodeClasses(language)
+  }
+  tree.language = language
+  if (input === undefined) {
+    tree.getText = getTextFromMappedFile
+  } else {
+    const {treeInput, getText} = treeInputFor(input, tree.encoding)
+    tree.input = treeInput
+    tree.getText = getText
+  }
+  return tree
+};
+
+// The bits of the `flags` column returned by `Tree.prototype.toFlatArrays`,
+// and of the `FLAGS` value read by `SyntaxNode.prototype.read`.
+Tree.FlatNodeFlags = Object.freeze({
+  NAMED: 1,
+  MISSING: 2,
+  ERROR: 4,
+});
+
 /*
  * Node
  */
@@ -246,13 +319,70 @@ class SyntaxNode {
     cursor.tree = this.tree;
     return cursor;
   }
+
+  traverse({types, namedOnly = false, maxDepth, startIndex, endIndex} = {}) {
+    marshalNode(this);
+    if (typeof types === 'string') types = [types]
+    const traversal = NodeMethods.traverse(this.tree, types, namedOnly, maxDepth, startIndex, endIndex);
+    traversal.tree = this.tree;
+    return traversal;
+  }
+
+  read(mask, out = new Uint32Array(SyntaxNode.readSize(mask))) {
+    singleNodeSlot[0] = this[0];
+    NodeMethods.readMany(this.tree, singleNodeSlot, mask, out);
+    return out;
+  }
+
+  // Reads the properties selected by `mask` for every node, in one call.
+  // All of the nodes must belong to the same tree.
+  static readMany(nodes, mask, out = new Uint32Array(nodes.length * SyntaxNode.readSize(mask))) {
+    if (nodes.length === 0) return out;
+    const {tree} = nodes[0];
+    const slots = new Uint32Array(nodes.length);
+    for (let i = 0; i < nodes.length; i++) {
+      if (nodes[i].tree !== tree) throw new Error('All nodes must belong to the same tree');
+      slots[i] = nodes[i][0];
+    }
+    NodeMethods.readMany(tree, slots, mask, out);
+    return out;
+  }
+
+  // The number of values that `read` produces for each node.
+  static readSize(mask) {
+    let size = 0;
+    for (const field of Object.values(SyntaxNode.ReadFields)) {
+      if (mask & field) size += READ_FIELD_SIZES[field] || 1;
+    }
+    return size;
+  }
 }
 
+// The properties that `read` and `readMany` can read, written for each node
+// in this order. Positions take two values, a row and a column.
+SyntaxNode.ReadFields = Object.freeze({
+  TYPE_ID: 1,
+  START_INDEX: 2,
+  END_INDEX: 4,
+  START_POSITION: 8,
+  END_POSITION: 16,
+  CHILD_COUNT: 32,
+  NAMED_CHILD_COUNT: 64,
+  FLAGS: 128,
+});
+
+const READ_FIELD_SIZES = {
+  [SyntaxNode.ReadFields.START_POSITION]: 2,
+  [SyntaxNode.ReadFields.END_POSITION]: 2,
+};
+
+const singleNodeSlot = new Uint32Array(1);
+
 /*
  * Parser
  */
 
-const {parse, parseTextBuffer, parseTextBufferSync, setLanguage} = Parser.prototype;
+const {parse, resumeParse, parseAsync, parseFile, parseTextBuffer, parseTextBufferSync, setLanguage} = Parser.prototype;
 const languageSymbol = Symbol('parser.language');
 
 Parser.prototype.setLanguage = function(language) {
@@ -268,28 +398,112 @@ Parser.prototype.getLanguage = function(language) {
   return this[languageSymbol] || null;
 };
 
-Parser.prototype.parse = function(input, oldTree, {bufferSize, includedRanges}={}) {
-  let getText, treeInput = input
-  if (typeof input === 'string') {
-    const inputString = input;
-    input = (offset, position) => inputString.slice(offset)
-    getText = getTextFromString
-  } else {
-    getText = getTextFromFunction
+Parser.prototype.parse = function(input, oldTree, {bufferSize, includedRanges, encoding, timeSliceMicros, signal}={}) {
+  if (timeSliceMicros && signal && signal.aborted) {
+    return Promise.reject(abortError(signal))
   }
+
+  const {treeInput, getText} = treeInputFor(input, encoding || this.getEncoding())
+  const finishTree = tree => {
+    if (tree) {
+      tree.input = treeInput
+      tree.getText = getText
+      tree.language = this.getLanguage()
+    }
+    return tree
+  }
+
   const tree = parse.call(
     this,
     input,
     oldTree,
     bufferSize,
-    includedRanges
+    includedRanges,
+    encoding,
+    timeSliceMicros
   );
-  if (tree) {
-    tree.input = treeInput
-    tree.getText = getText
-    tree.language = this.getLanguage()
+  if (tree !== undefined) return finishTree(tree)
+
+  // The first time slice ran out before the parse finished. Resume it on
+  // later turns of the event loop, one slice at a time.
+  return new Promise((resolve, reject) => {
+    const stopListening = cancelOnAbort(this, signal)
+    const resume = () => {
+      let result
+      try {
+        result = resumeParse.call(this)
+      } catch (error) {
+        stopListening()
+        reject(error)
+        return
+      }
+      if (result === undefined) {
+        setImmediate(resume)
+        return
+      }
+      stopListening()
+      if (!result && signal && signal.aborted) {
+        reject(abortError(signal))
+      } else {
+        resolve(finishTree(result))
+      }
+    }
+    setImmediate(resume)
+  })
+};
+
+Parser.prototype.parseAsync = function(input, oldTree, {includedRanges, encoding, signal}={}) {
+  return new Promise((resolve, reject) => {
+    if (signal && signal.aborted) throw abortError(signal)
+    const {treeInput, getText} = treeInputFor(input, encoding || this.getEncoding())
+    parseAsync.call(
+      this,
+      tree => {
+        stopListening()
+        if (!tree && signal && signal.aborted) {
+          reject(abortError(signal))
+          return
+        }
+        if (tree) {
+          tree.input = treeInput
+          tree.getText = getText
+          tree.language = this.getLanguage()
+        }
+        resolve(tree)
+      },
+      input,
+      oldTree,
+      includedRanges,
+      encoding
+    );
+    const stopListening = cancelOnAbort(this, signal)
+  })
+};
+
+Parser.prototype.parseFile = function(path, {encoding, includedRanges, async, signal}={}) {
+  const finishTree = tree => {
+    if (tree) {
+      tree.input = path
+      tree.getText = getTextFromMappedFile
+      tree.language = this.getLanguage()
+    }
+    return tree
   }
-  return tree
+
+  if (async) {
+    return new Promise((resolve, reject) => {
+      if (signal && signal.aborted) throw abortError(signal)
+      parseFile.call(this, path, encoding, includedRanges, (error, tree) => {
+        stopListening()
+        if (error) reject(error)
+        else if (!tree && signal && signal.aborted) reject(abortError(signal))
+        else resolve(finishTree(tree))
+      });
+      const stopListening = cancelOnAbort(this, signal)
+    })
+  }
+
+  return finishTree(parseFile.call(this, path, encoding, includedRanges))
 };
 
 Parser.prototype.parseTextBuffer = function(
@@ -336,6 +550,48 @@ Parser.prototype.parseTextBufferSync = function(buffer, oldTree, {includedRanges
   return tree;
 };
 
+/*
+ * ParserPool
+ */
+
+const {parseMany, setLanguage: setPoolLanguage} = ParserPool.prototype;
+
+ParserPool.prototype.setLanguage = function(language) {
+  setPoolLanguage.call(this, language);
+  this[languageSymbol] = language;
+  if (!language.nodeSubclasses) {
+    initializeLanguageNodeClasses(language)
+  }
+  return this;
+};
+
+ParserPool.prototype.getLanguage = Parser.prototype.getLanguage;
+
+ParserPool.prototype.parseMany = function(inputs, {encoding, onTree} = {}) {
+  return new Promise((resolve, reject) => {
+    const language = this.getLanguage()
+    const trees = new Array(inputs.length)
+    let firstError = null
+    parseMany.call(
+      this,
+      () => firstError ? reject(firstError) : resolve(trees),
+      (error, index, tree, contents) => {
+        if (error) {
+          firstError = firstError || error
+          return
+        }
+        tree.input = contents || toBuffer(inputs[index])
+        tree.getText = getTextFromBuffer
+        tree.language = language
+        trees[index] = tree
+        if (onTree) onTree(tree, index)
+      },
+      inputs,
+      encoding
+    );
+  })
+};
+
 /*
  * TreeCursor
  */
@@ -372,11 +628,28 @@ TreeCursor.prototype.reset = function(node) {
   reset.call(this);
 }
 
+/*
+ * TreeTraversal
+ */
+
+const {_nodeAt: traversalNodeAt} = TreeTraversal.prototype;
+
+TreeTraversal.prototype.nodeAt = function(events, offset) {
+  const index = offset / TreeTraversal.EVENT_SIZE;
+  return unmarshalNode(traversalNodeAt.call(this, index, events[offset + 1]), this.tree);
+};
+
+TreeTraversal.prototype[Symbol.iterator] = function*() {
+  for (let events; (events = this.next()) !== null;) {
+    yield events;
+  }
+};
+
 /*
  * Query
  */
 
-const {_matches, _captures} = Query.prototype;
+const {_matches, _captures, _capturesCompact, _iterMatches, _matchesAsync} = Query.prototype;
 
 const PREDICATE_STEP_TYPE = {
   DONE: 0,
@@ -386,7 +659,7 @@ const PREDICATE_STEP_TYPE = {
 
 const ZERO_POINT = { row: 0, column: 0 };
 
-Query.prototype._init = function() {
+Query.prototype._init = function(compiledPredicates) {
   /*
    * Initialize predicate functions
    * format: [type1, value1, type2, value2, ...]
@@ -399,14 +672,20 @@ Query.prototype._init = function() {
   const refutedProperties = new Array(patternCount);
   const predicates = new Array(patternCount);
 
+  // The predicates that still have to run in JS when the native side has
+  // already checked the compiled ones against the source text.
+  const remainingPredicates = new Array(patternCount);
+
   const FIRST  = 0
   const SECOND = 2
   const THIRD  = 4
 
   for (let i = 0; i < predicateDescriptions.length; i++) {
     predicates[i] = [];
+    remainingPredicates[i] = [];
 
     for (let j = 0; j < predicateDescriptions[i].length; j++) {
+      const predicateCount = predicates[i].length;
 
       const steps = predicateDescriptions[i][j];
       const stepsLength = steps.length / 2;
@@ -502,22 +781,84 @@ Query.prototype._init = function() {
         default:
           throw new Error(`Unknown query predicate \`#${steps[FIRST + 1]}\``);
       }
+
+      if (predicates[i].length > predicateCount && !compiledPredicates[i][j]) {
+        remainingPredicates[i].push(predicates[i][predicateCount]);
+      }
     }
   }
 
   this.predicates = Object.freeze(predicates);
+  this._remainingPredicates = remainingPredicates;
+  this._hasTextPredicates = predicates.some(p => p.length > 0);
+  this._hasRemainingPredicates = remainingPredicates.some(p => p.length > 0);
+  this.captureNames = Object.freeze(this._getCaptureNames());
+  this._captureIds = new Map(this.captureNames.map((name, id) => [name, id]));
   this.setProperties = Object.freeze(setProperties);
   this.assertedProperties = Object.freeze(assertedProperties);
   this.refutedProperties = Object.freeze(refutedProperties);
 }
 
-Query.prototype.matches = function(rootNode, startPosition = ZERO_POINT, endPosition = ZERO_POINT) {
+Query.prototype.matches = function(
+  rootNode,
+  startPosition = ZERO_POINT,
+  endPosition = ZERO_POINT,
+  {matchLimit} = {}
+) {
   marshalNode(rootNode);
-  const [returnedMatches, returnedNodes] = _matches.call(this, rootNode.tree,
+  const [returnedMatches, returnedNodes, checkedText] = _matches.call(this, rootNode.tree,
     startPosition.row, startPosition.column,
-    endPosition.row, endPosition.column
+    endPosition.row, endPosition.column,
+    querySource(this, rootNode.tree),
+    matchLimit
+  );
+  return unmarshalMatches(this, rootNode.tree, returnedMatches, returnedNodes, checkedText);
+}
+
+// Yields the matches lazily. The native iterator holds its own query cursor
+// and returns at most `chunkSize` matches at a time, so a caller that stops
+// early never pays for the matches it didn't look at. The returned generator
+// has a `didExceedMatchLimit` method of its own, because other executions of
+// the query can run while it is suspended.
+Query.prototype.iterMatches = function(rootNode, {
+  startPosition = ZERO_POINT,
+  endPosition = ZERO_POINT,
+  limit = Infinity,
+  chunkSize = 64,
+  matchLimit,
+} = {}) {
+  marshalNode(rootNode);
+  const {tree} = rootNode;
+  const iterator = _iterMatches.call(this, tree,
+    startPosition.row, startPosition.column,
+    endPosition.row, endPosition.column,
+    matchLimit
   );
-  const nodes = unmarshalNodes(returnedNodes, rootNode.tree);
+  iterator.tree = tree;
+  iterator.query = this;
+  iterator.source = querySource(this, tree);
+
+  const generator = iterateMatches(this, tree, iterator, limit, chunkSize);
+  generator.didExceedMatchLimit = () => iterator.didExceedMatchLimit();
+  return generator;
+}
+
+function* iterateMatches(query, tree, iterator, limit, chunkSize) {
+  let count = 0;
+  while (count < limit) {
+    const chunk = iterator.next(Math.min(chunkSize, limit - count));
+    if (chunk === null) return;
+    const [returnedMatches, returnedNodes, checkedText] = chunk;
+    for (const match of unmarshalMatches(query, tree, returnedMatches, returnedNodes, checkedText)) {
+      yield match;
+      if (++count >= limit) return;
+    }
+  }
+}
+
+function unmarshalMatches(query, tree, returnedMatches, returnedNodes, checkedText) {
+  const nodes = unmarshalNodes(returnedNodes, tree);
+  const predicates = checkedText ? query._remainingPredicates : query.predicates;
   const results = [];
 
   let i = 0
@@ -534,11 +875,11 @@ Query.prototype.matches = function(rootNode, startPosition = ZERO_POINT, endPosi
       })
     }
 
-    if (this.predicates[patternIndex].every(p => p(captures))) {
+    if (predicates[patternIndex].every(p => p(captures))) {
       const result = {pattern: patternIndex, captures};
-      const setProperties = this.setProperties[patternIndex];
-      const assertedProperties = this.assertedProperties[patternIndex];
-      const refutedProperties = this.refutedProperties[patternIndex];
+      const setProperties = query.setProperties[patternIndex];
+      const assertedProperties = query.assertedProperties[patternIndex];
+      const refutedProperties = query.refutedProperties[patternIndex];
       if (setProperties) result.setProperties = setProperties;
       if (assertedProperties) result.assertedProperties = assertedProperties;
       if (refutedProperties) result.refutedProperties = refutedProperties;
@@ -549,13 +890,28 @@ Query.prototype.matches = function(rootNode, startPosition = ZERO_POINT, endPosi
   return results;
 }
 
-Query.prototype.captures = function(rootNode, startPosition = ZERO_POINT, endPosition = ZERO_POINT) {
+Query.prototype.captures = function(
+  rootNode,
+  startPosition = ZERO_POINT,
+  endPosition = ZERO_POINT,
+  {matchLimit} = {}
+) {
   marshalNode(rootNode);
-  const [returnedMatches, returnedNodes] = _captures.call(this, rootNode.tree,
+  const [returnedMatches, returnedNodes, checkedText] = _captures.call(this, rootNode.tree,
     startPosition.row, startPosition.column,
-    endPosition.row, endPosition.column
+    endPosition.row, endPosition.column,
+    querySource(this, rootNode.tree),
+    matchLimit
   );
-  const nodes = unmarshalNodes(returnedNodes, rootNode.tree);
+  return unmarshalCaptures(this, rootNode.tree, returnedMatches, returnedNodes, checkedText).captures;
+}
+
+// Decodes the captures returned natively and drops those whose match fails
+// a predicate. `patterns[i]` is the pattern index of `captures[i]`.
+function unmarshalCaptures(query, tree, returnedMatches, returnedNodes, checkedText) {
+  const nodes = unmarshalNodes(returnedNodes, tree);
+  const predicates = checkedText ? query._remainingPredicates : query.predicates;
+  const patterns = [];
   const results = [];
 
   let i = 0
@@ -573,19 +929,131 @@ Query.prototype.captures = function(rootNode, startPosition = ZERO_POINT, endPos
       })
     }
 
-    if (this.predicates[patternIndex].every(p => p(captures))) {
+    if (predicates[patternIndex].every(p => p(captures))) {
       const result = captures[captureIndex];
-      const setProperties = this.setProperties[patternIndex];
-      const assertedProperties = this.assertedProperties[patternIndex];
-      const refutedProperties = this.refutedProperties[patternIndex];
+      const setProperties = query.setProperties[patternIndex];
+      const assertedProperties = query.assertedProperties[patternIndex];
+      const refutedProperties = query.refutedProperties[patternIndex];
       if (setProperties) result.setProperties = setProperties;
       if (assertedProperties) result.assertedProperties = assertedProperties;
       if (refutedProperties) result.refutedProperties = refutedProperties;
+      patterns.push(patternIndex);
       results.push(result);
     }
   }
 
-  return results;
+  return {patterns, captures: results};
+}
+
+// Appends a capture to `values` in the form returned by `capturesCompact`.
+function pushCompactCapture(values, query, pattern, {name, node}) {
+  const {startPosition, endPosition} = node;
+  values.push(
+    pattern, query._captureIds.get(name),
+    node.startIndex, node.endIndex,
+    startPosition.row, startPosition.column,
+    endPosition.row, endPosition.column
+  );
+}
+
+// Returns the captures as a Uint32Array with `CAPTURE_SIZE` values per
+// capture: the pattern index, the capture's index in `query.captureNames`,
+// the start and end index, and the start and end row and column. No nodes
+// or strings are created, unless some predicates can only be checked in JS.
+Query.prototype.capturesCompact = function(
+  rootNode,
+  startPosition = ZERO_POINT,
+  endPosition = ZERO_POINT,
+  {matchLimit} = {}
+) {
+  marshalNode(rootNode);
+  const {tree} = rootNode;
+  const source = querySource(this, tree);
+  if (!this._hasRemainingPredicates) {
+    const result = _capturesCompact.call(this, tree,
+      startPosition.row, startPosition.column,
+      endPosition.row, endPosition.column,
+      source,
+      matchLimit,
+      this._hasTextPredicates
+    );
+    if (result !== null) return result;
+  }
+
+  const [returnedMatches, returnedNodes, checkedText] = _captures.call(this, tree,
+    startPosition.row, startPosition.column,
+    endPosition.row, endPosition.column,
+    source,
+    matchLimit
+  );
+  const {patterns, captures} = unmarshalCaptures(this, tree, returnedMatches, returnedNodes, checkedText);
+  const values = [];
+  captures.forEach((capture, i) => pushCompactCapture(values, this, patterns[i], capture));
+  return Uint32Array.from(values);
+}
+
+// Runs the query on the thread pool and resolves with the matches in a
+// compact form: `patterns` has each match's pattern index, and the captures
+// of match `i` are rows `captureOffsets[i]` to `captureOffsets[i + 1]` of
+// `captures`, in the form returned by `capturesCompact`. `didExceedMatchLimit`
+// tells whether this execution reached its match limit. When some
+// predicates can only be checked in JS, the query runs synchronously.
+Query.prototype.matchesAsync = function(
+  rootNode,
+  startPosition = ZERO_POINT,
+  endPosition = ZERO_POINT,
+  {matchLimit} = {}
+) {
+  return new Promise((resolve, reject) => {
+    marshalNode(rootNode);
+    const {tree} = rootNode;
+    const started = !this._hasRemainingPredicates && _matchesAsync.call(this,
+      (error, result) => error ? reject(error) : resolve(result),
+      tree,
+      startPosition.row, startPosition.column,
+      endPosition.row, endPosition.column,
+      querySource(this, tree),
+      matchLimit,
+      this._hasTextPredicates
+    );
+    if (started) return;
+
+    const matches = this.matches(rootNode, startPosition, endPosition, {matchLimit});
+    const didExceedMatchLimit = this.didExceedMatchLimit();
+    const patterns = new Uint32Array(matches.length);
+    const captureOffsets = new Uint32Array(matches.length + 1);
+    const captures = [];
+    matches.forEach(({pattern, captures: matchCaptures}, i) => {
+      patterns[i] = pattern;
+      for (const capture of matchCaptures) {
+        pushCompactCapture(captures, this, pattern, capture);
+      }
+      captureOffsets[i + 1] = captures.length / Query.CAPTURE_SIZE;
+    });
+    resolve({
+      patterns,
+      captureOffsets,
+      captures: Uint32Array.from(captures),
+      didExceedMatchLimit,
+    });
+  });
+}
+
+// The source text of a tree, in the tree's encoding, for checking query
+// predicates natively. Trees parsed from a file are read from their mapping
+// instead, and trees whose input is a function or a text buffer are left to
+// the JS predicates. Queries without text predicates need no text at all.
+function querySource (query, tree) {
+  if (!query._hasTextPredicates) return undefined
+  const {getText, input} = tree
+  if (getText === getTextFromString || getText === getTextFromUTF8String) {
+    if (!tree.inputBuffer) {
+      tree.inputBuffer = Buffer.from(input, tree.encoding === 'utf8' ? 'utf8' : 'utf16le')
+    }
+    return tree.inputBuffer
+  }
+  if (getText === getTextFromBuffer) return input
+  return undefined
 }
 
 /*
@@ -596,8 +1064,27 @@ function getTextFromString (node) {
   return this.input.substring(node.startIndex, node.endIndex);
 }
 
+function getTextFromUTF8String ({startIndex, endIndex}) {
+  if (!this.inputBuffer) this.inputBuffer = Buffer.from(this.input, 'utf8');
+  return this.inputBuffer.toString('utf8', startIndex, endIndex);
+}
+
+function getTextFromBuffer ({startIndex, endIndex}) {
+  if (this.encoding === 'utf8') {
+    return this.input.toString('utf8', startIndex, endIndex);
+  }
+  return this.input.toString('utf16le', startIndex * 2, endIndex * 2);
+}
+
+function getTextFromMappedFile ({startIndex, endIndex}) {
+  return this._sourceText(startIndex, endIndex);
+}
+
 function getTextFromFunction ({startIndex, endIndex}) {
   const {input} = this
+  if (this.encoding === 'utf8') {
+    return getUTF8TextFromFunction(input, startIndex, endIndex);
+  }
   let result = '';
   const goalLength = endIndex - startIndex;
   while (result.length < goalLength) {
@@ -607,79 +1094,114 @@ function getTextFromFunction ({startIndex, endIndex}) {
   return result.substr(0, goalLength);
 }
 
+function getUTF8TextFromFunction (input, startIndex, endIndex) {
+  const chunks = [];
+  let length = 0;
+  const goalLength = endIndex - startIndex;
+  while (length < goalLength) {
+    const text = input(startIndex + length);
+    const chunk = typeof text === 'string' ? Buffer.from(text, 'utf8') : text;
+    chunks.push(chunk);
+    length += chunk.length;
+  }
+  return Buffer.concat(chunks).toString('utf8', 0, goalLength);
+}
+
 function getTextFromTextBuffer ({startPosition, endPosition}) {
   return this.input.getTextInRange({start: startPosition, end: endPosition});
 }
 
+// Cancels the parser's current background parse when the signal is aborted.
+// Returns a function that removes the listener again.
+function cancelOnAbort (parser, signal) {
+  if (!signal) return () => {}
+  const onAbort = () => parser.cancel()
+  signal.addEventListener('abort', onAbort)
+  return () => signal.removeEventListener('abort', onAbort)
+}
+
+function abortError (signal) {
+  if (signal.reason !== undefined) return signal.reason
+  const error = new Error('The parse was aborted')
+  error.name = 'AbortError'
+  return error
+}
+
+function treeInputFor (input, encoding) {
+  if (typeof input === 'string') {
+    // UTF8 byte offsets match string indices as long as the input is ASCII.
+    if (encoding === 'utf8' && Buffer.byteLength(input, 'utf8') !== input.length) {
+      return {treeInput: input, getText: getTextFromUTF8String}
+    }
+    return {treeInput: input, getText: getTextFromString}
+  }
+  if (isBinaryInput(input)) {
+    return {treeInput: toBuffer(input), getText: getTextFromBuffer}
+  }
+  return {treeInput: input, getText: getTextFromFunction}
+}
+
+function isBinaryInput (input) {
+  return input instanceof ArrayBuffer || ArrayBuffer.isView(input);
+}
+
+function toBuffer (input) {
+  if (Buffer.isBuffer(input)) return input;
+  if (input instanceof ArrayBuffer) return Buffer.from(input);
+  return Buffer.from(input.buffer, input.byteOffset, input.byteLength);
+}
+
 const {pointTransferArray} = binding;
 
-const NODE_FIELD_COUNT = 6;
+// A transferred node is its slot in the tree's native node table, which is
+// also the only field that a SyntaxNode keeps.
+const NODE_FIELD_COUNT = 1;
+
+// Each tree keeps its SyntaxNodes in an array indexed by slot, so that a node
+// is always represented by the same object, until the tree's nodes are
+// released.
+const nodesSymbol = Symbol('tree.nodes');
+
+// The slot of a node whose tree has released its nodes. It is past the end
+// of every node table, so it reads as a null node.
+const DETACHED_SLOT = 0xFFFFFFFF;
 const ERROR_TYPE_ID = 0xFFFF
 
-function getID(buffer, offset) {
-  const low  = BigInt(buffer[offset]);
-  const high = BigInt(buffer[offset + 1]);
-  return (high << 32n) + low;
+function unmarshalNode(value, tree, offset = 0) {
+  if (value === null || value === undefined) {
+    return null;
+  }
+  return nodeForSlot(tree, binding.nodeTransferArray[offset], value);
 }
 
-function unmarshalNode(value, tree, offset = 0, cache = null) {
-  /* case 1: node from the tree cache */
-  if (typeof value === 'object') {
-    const node = value;
-    return node;
-  }
+function nodeForSlot(tree, slot, nodeTypeId) {
+  const nodes = tree[nodesSymbol] || (tree[nodesSymbol] = []);
+  const cachedResult = nodes[slot];
+  if (cachedResult) return cachedResult;
 
-  /* case 2: node being transferred */
-  const nodeTypeId = value;
   const NodeClass = nodeTypeId === ERROR_TYPE_ID
     ? SyntaxNode
     : tree.language.nodeSubclasses[nodeTypeId];
 
-  const {nodeTransferArray} = binding;
-  const id = getID(nodeTransferArray, offset)
-  if (id === 0n) {
-    return null
-  }
-
-  let cachedResult;
-  if (cache && (cachedResult = cache.get(id)))
-    return cachedResult;
-
   const result = new NodeClass(tree);
-  for (let i = 0; i < NODE_FIELD_COUNT; i++) {
-    result[i] = nodeTransferArray[offset + i];
-  }
-
-  if (cache)
-    cache.set(id, result);
-  else
-    tree._cacheNode(result);
-
+  result[0] = slot;
+  nodes[slot] = result;
   return result;
 }
 
 function unmarshalNodes(nodes, tree) {
-  const cache = new Map();
-
   let offset = 0;
   for (let i = 0, {length} = nodes; i < length; i++) {
-    const node = unmarshalNode(nodes[i], tree, offset, cache);
-    if (node !== nodes[i]) {
-      nodes[i] = node;
+    if (nodes[i] !== null) {
+      nodes[i] = unmarshalNode(nodes[i], tree, offset);
       offset += NODE_FIELD_COUNT
     }
   }
-
-  tree._cacheNodes(Array.from(cache.values()));
-
   return nodes;
 }
 
 function marshalNode(node) {
-  const {nodeTransferArray} = binding;
-  for (let i = 0; i < NODE_FIELD_COUNT; i++) {
-    nodeTransferArray[i] = node[i];
-  }
+  binding.nodeTransferArray[0] = node[0];
 }
 
 function unmarshalPoint() {
@@ -751,6 +1273,8 @@ function camelCase(name, upperCase) {
 
 module.exports = Parser;
 module.exports.Query = Query;
+module.exports.ParserPool = ParserPool;
 module.exports.Tree = Tree;
 module.exports.SyntaxNode = SyntaxNode;
 module.exports.TreeCursor = TreeCursor;
+module.exports.TreeTraversal = TreeTraversal;
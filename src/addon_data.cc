@@ -0,0 +1,47 @@
+#include "./addon_data.h"
+#include <node.h>
+#include <cstdlib>
+
+namespace node_tree_sitter {
+
+thread_local AddonData *AddonData::current_ = nullptr;
+
+AddonData *AddonData::Init(v8::Isolate *isolate, v8::Local<v8::Object> exports) {
+  // The binding can be loaded by more than one environment of the same
+  // isolate, in which case the later loads share the existing state.
+  if (!current_) current_ = new AddonData();
+
+  Environment *environment = new Environment();
+  environment->data = current_;
+  environment->exports = current_->module_exports.emplace(current_->module_exports.end());
+  environment->exports->Reset(exports);
+  current_->environment_count_++;
+  #if NODE_MAJOR_VERSION >= 12
+    node::AddEnvironmentCleanupHook(isolate, Cleanup, environment);
+  #endif
+  return current_;
+}
+
+AddonData::~AddonData() {
+  free(point_transfer_buffer);
+  free(transfer_buffer);
+  if (scratch_cursor.tree) ts_tree_cursor_delete(&scratch_cursor);
+  for (TSQueryCursor *cursor : query_cursors) ts_query_cursor_delete(cursor);
+}
+
+// Runs for each environment while the isolate is still alive, so the
+// persistent handles can still be reset. The state is deleted along with
+// the last environment that uses it.
+void AddonData::Cleanup(void *arg) {
+  Environment *environment = static_cast<Environment *>(arg);
+  AddonData *addon_data = environment->data;
+  environment->exports->Reset();
+  addon_data->module_exports.erase(environment->exports);
+  delete environment;
+
+  if (--addon_data->environment_count_ > 0) return;
+  if (current_ == addon_data) current_ = nullptr;
+  delete addon_data;
+}
+
+}  // namespace node_tree_sitter
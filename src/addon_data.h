@@ -0,0 +1,80 @@
+#ifndef NODE_TREE_SITTER_ADDON_DATA_H_
+#define NODE_TREE_SITTER_ADDON_DATA_H_
+
+#include <v8.h>
+#include <nan.h>
+#include <list>
+#include <vector>
+#include <tree_sitter/api.h>
+
+namespace node_tree_sitter {
+
+// The binding's state for one isolate. The main thread and each worker
+// thread that loads the binding get their own instance, so transfer
+// buffers, cursors and constructors are never shared between threads.
+//
+// Node runs each isolate on a thread of its own, so the current instance
+// is found through a thread-local pointer, which is cheap enough for the
+// hot node getters. Environments that share an isolate, such as several
+// contexts of an embedder, share its instance. Each of them holds a
+// reference that its own cleanup hook releases.
+class AddonData {
+ public:
+  static AddonData *Init(v8::Isolate *, v8::Local<v8::Object> exports);
+  static inline AddonData *Get() { return current_; }
+
+  // Stores a handle unless an earlier environment already did, so that a
+  // later load does not replace the constructors of existing objects.
+  template <typename T>
+  static void SetOnce(Nan::Persistent<T> &handle, v8::Local<T> value) {
+    if (handle.IsEmpty()) handle.Reset(value);
+  }
+
+  // conversions.cc
+  uint32_t *point_transfer_buffer = nullptr;
+  Nan::Persistent<v8::String> row_key;
+  Nan::Persistent<v8::String> column_key;
+  Nan::Persistent<v8::String> start_index_key;
+  Nan::Persistent<v8::String> start_position_key;
+  Nan::Persistent<v8::String> end_index_key;
+  Nan::Persistent<v8::String> end_position_key;
+
+  // node.cc
+  uint32_t *transfer_buffer = nullptr;
+  uint32_t transfer_buffer_length = 0;
+  // The exports of each environment, which all expose the transfer buffer.
+  std::list<Nan::Persistent<v8::Object>> module_exports;
+  TSTreeCursor scratch_cursor = {nullptr, nullptr, {0, 0}};
+
+  // query.cc
+  std::vector<TSQueryCursor *> query_cursors;
+
+  // The constructors of the wrapped classes.
+  Nan::Persistent<v8::Function> parser_constructor;
+  Nan::Persistent<v8::Function> parser_pool_constructor;
+  Nan::Persistent<v8::Function> query_constructor;
+  Nan::Persistent<v8::FunctionTemplate> query_constructor_template;
+  Nan::Persistent<v8::Function> query_match_iterator_constructor;
+  Nan::Persistent<v8::Function> tree_constructor;
+  Nan::Persistent<v8::FunctionTemplate> tree_constructor_template;
+  Nan::Persistent<v8::Function> tree_cursor_constructor;
+  Nan::Persistent<v8::Function> tree_traversal_constructor;
+
+ private:
+  struct Environment {
+    AddonData *data;
+    std::list<Nan::Persistent<v8::Object>>::iterator exports;
+  };
+
+  AddonData() = default;
+  ~AddonData();
+
+  static void Cleanup(void *);
+
+  static thread_local AddonData *current_;
+  uint32_t environment_count_ = 0;
+};
+
+}  // namespace node_tree_sitter
+
+#endif  // NODE_TREE_SITTER_ADDON_DATA_H_
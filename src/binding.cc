@@ -1,11 +1,15 @@
 #include <node.h>
 #include <v8.h>
+#include "./addon_data.h"
 #include "./language.h"
 #include "./node.h"
 #include "./parser.h"
+#include "./parser_pool.h"
 #include "./query.h"
+#include "./query_match_iterator.h"
 #include "./tree.h"
 #include "./tree_cursor.h"
+#include "./tree_traversal.h"
 #include "./conversions.h"
 
 namespace node_tree_sitter {
@@ -13,15 +17,19 @@ namespace node_tree_sitter {
 using namespace v8;
 
 void InitAll(Local<Object> exports) {
+  AddonData::Init(Isolate::GetCurrent(), exports);
   InitConversions(exports);
   node_methods::Init(exports);
   language_methods::Init(exports);
   Parser::Init(exports);
+  ParserPool::Init(exports);
   Query::Init(exports);
+  QueryMatchIterator::Init(exports);
   Tree::Init(exports);
   TreeCursor::Init(exports);
+  TreeTraversal::Init(exports);
 }
 
-NODE_MODULE(tree_sitter_runtime_binding, InitAll)
+NAN_MODULE_WORKER_ENABLED(tree_sitter_runtime_binding, InitAll)
 
 }  // namespace node_tree_sitter
@@ -0,0 +1,62 @@
+#ifndef NODE_TREE_SITTER_BUFFER_INPUT_H_
+#define NODE_TREE_SITTER_BUFFER_INPUT_H_
+
+#include <v8.h>
+#include <nan.h>
+#include <tree_sitter/api.h>
+
+namespace node_tree_sitter {
+
+// Reads text that is already encoded in a contiguous block of memory, such as
+// the backing store of a Buffer or an ArrayBuffer.
+class BufferInput {
+ public:
+  BufferInput(const char *data, size_t length, TSInputEncoding encoding)
+    : data_(data),
+      length_(encoding == TSInputEncodingUTF16 ? length & ~static_cast<size_t>(1) : length),
+      encoding_(encoding) {}
+
+  TSInput input() {
+    return TSInput{this, Read, encoding_};
+  }
+
+ private:
+  static const char *Read(void *payload, uint32_t byte, TSPoint position, uint32_t *bytes_read) {
+    auto self = static_cast<BufferInput *>(payload);
+    if (byte >= self->length_) {
+      *bytes_read = 0;
+      return "";
+    }
+    *bytes_read = self->length_ - byte;
+    return self->data_ + byte;
+  }
+
+  const char *data_;
+  size_t length_;
+  TSInputEncoding encoding_;
+};
+
+static inline bool buffer_contents(v8::Local<v8::Value> value, const char **data, size_t *length) {
+  if (value->IsArrayBufferView()) {
+    *data = node::Buffer::Data(value);
+    *length = node::Buffer::Length(value);
+    return true;
+  }
+
+  if (value->IsArrayBuffer()) {
+    auto array_buffer = v8::Local<v8::ArrayBuffer>::Cast(value);
+    #if V8_MAJOR_VERSION >= 8
+      *data = static_cast<const char *>(array_buffer->GetBackingStore()->Data());
+    #else
+      *data = static_cast<const char *>(array_buffer->GetContents().Data());
+    #endif
+    *length = array_buffer->ByteLength();
+    return true;
+  }
+
+  return false;
+}
+
+}  // namespace node_tree_sitter
+
+#endif  // NODE_TREE_SITTER_BUFFER_INPUT_H_
@@ -3,31 +3,27 @@
 #include <tree_sitter/api.h>
 #include <v8.h>
 #include "./conversions.h"
+#include "./addon_data.h"
 #include <cmath>
+#include <string>
 
 namespace node_tree_sitter {
 
 using namespace v8;
 
-Nan::Persistent<String> row_key;
-Nan::Persistent<String> column_key;
-Nan::Persistent<String> start_index_key;
-Nan::Persistent<String> start_position_key;
-Nan::Persistent<String> end_index_key;
-Nan::Persistent<String> end_position_key;
-
-static unsigned BYTES_PER_CHARACTER = 2;
-static uint32_t *point_transfer_buffer;
-
 void InitConversions(Local<Object> exports) {
-  row_key.Reset(Nan::Persistent<String>(Nan::New("row").ToLocalChecked()));
-  column_key.Reset(Nan::Persistent<String>(Nan::New("column").ToLocalChecked()));
-  start_index_key.Reset(Nan::Persistent<String>(Nan::New("startIndex").ToLocalChecked()));
-  start_position_key.Reset(Nan::Persistent<String>(Nan::New("startPosition").ToLocalChecked()));
-  end_index_key.Reset(Nan::Persistent<String>(Nan::New("endIndex").ToLocalChecked()));
-  end_position_key.Reset(Nan::Persistent<String>(Nan::New("endPosition").ToLocalChecked()));
-
-  point_transfer_buffer = static_cast<uint32_t *>(malloc(2 * sizeof(uint32_t)));
+  AddonData *data = AddonData::Get();
+  AddonData::SetOnce(data->row_key, Nan::New("row").ToLocalChecked());
+  AddonData::SetOnce(data->column_key, Nan::New("column").ToLocalChecked());
+  AddonData::SetOnce(data->start_index_key, Nan::New("startIndex").ToLocalChecked());
+  AddonData::SetOnce(data->start_position_key, Nan::New("startPosition").ToLocalChecked());
+  AddonData::SetOnce(data->end_index_key, Nan::New("endIndex").ToLocalChecked());
+  AddonData::SetOnce(data->end_position_key, Nan::New("endPosition").ToLocalChecked());
+
+  if (!data->point_transfer_buffer) {
+    data->point_transfer_buffer = static_cast<uint32_t *>(malloc(2 * sizeof(uint32_t)));
+  }
+  uint32_t *point_transfer_buffer = data->point_transfer_buffer;
 
   #if _MSC_VER && NODE_RUNTIME_ELECTRON && NODE_MODULE_VERSION >= 89
     // this is a terrible thing we have to do because of https://github.com/electron/electron/issues/29893
@@ -44,21 +40,23 @@ void InitConversions(Local<Object> exports) {
   Nan::Set(exports, Nan::New("pointTransferArray").ToLocalChecked(), Uint32Array::New(js_point_transfer_buffer, 0, 2));
 }
 
-void TransferPoint(const TSPoint &point) {
+void TransferPoint(const TSPoint &point, TSInputEncoding encoding) {
+  uint32_t *point_transfer_buffer = AddonData::Get()->point_transfer_buffer;
   point_transfer_buffer[0] = point.row;
-  point_transfer_buffer[1] = point.column / 2;
+  point_transfer_buffer[1] = point.column / BytesPerCharacter(encoding);
 }
 
-Local<Object> RangeToJS(const TSRange &range) {
+Local<Object> RangeToJS(const TSRange &range, TSInputEncoding encoding) {
+  AddonData *data = AddonData::Get();
   Local<Object> result = Nan::New<Object>();
-  Nan::Set(result, Nan::New(start_position_key), PointToJS(range.start_point));
-  Nan::Set(result, Nan::New(start_index_key), ByteCountToJS(range.start_byte));
-  Nan::Set(result, Nan::New(end_position_key), PointToJS(range.end_point));
-  Nan::Set(result, Nan::New(end_index_key), ByteCountToJS(range.end_byte));
+  Nan::Set(result, Nan::New(data->start_position_key), PointToJS(range.start_point, encoding));
+  Nan::Set(result, Nan::New(data->start_index_key), ByteCountToJS(range.start_byte, encoding));
+  Nan::Set(result, Nan::New(data->end_position_key), PointToJS(range.end_point, encoding));
+  Nan::Set(result, Nan::New(data->end_index_key), ByteCountToJS(range.end_byte, encoding));
   return result;
 }
 
-Nan::Maybe<TSRange> RangeFromJS(const Local<Value> &arg) {
+Nan::Maybe<TSRange> RangeFromJS(const Local<Value> &arg, TSInputEncoding encoding) {
   if (!arg->IsObject()) {
     Nan::ThrowTypeError("Range must be a {startPosition, endPosition, startIndex, endIndex} object");
     return Nan::Nothing<TSRange>();
@@ -74,7 +72,7 @@ Nan::Maybe<TSRange> RangeFromJS(const Local<Value> &arg) {
       Nan::ThrowTypeError("Range must be a {startPosition, endPosition, startIndex, endIndex} object"); \
       return Nan::Nothing<TSRange>(); \
     } \
-    auto field = Convert(value.ToLocalChecked()); \
+    auto field = Convert(value.ToLocalChecked(), encoding); \
     if (field.IsJust()) { \
       result.field = field.FromJust(); \
     } else { \
@@ -82,38 +80,41 @@ Nan::Maybe<TSRange> RangeFromJS(const Local<Value> &arg) {
     } \
   }
 
-  INIT(start_point, start_position_key, PointFromJS);
-  INIT(end_point, end_position_key, PointFromJS);
-  INIT(start_byte, start_index_key, ByteCountFromJS);
-  INIT(end_byte, end_index_key, ByteCountFromJS);
+  AddonData *data = AddonData::Get();
+  INIT(start_point, data->start_position_key, PointFromJS);
+  INIT(end_point, data->end_position_key, PointFromJS);
+  INIT(start_byte, data->start_index_key, ByteCountFromJS);
+  INIT(end_byte, data->end_index_key, ByteCountFromJS);
 
   #undef INIT
 
   return Nan::Just(result);
 }
 
-Local<Object> PointToJS(const TSPoint &point) {
+Local<Object> PointToJS(const TSPoint &point, TSInputEncoding encoding) {
+  AddonData *data = AddonData::Get();
   Local<Object> result = Nan::New<Object>();
-  Nan::Set(result, Nan::New(row_key), Nan::New<Number>(point.row));
-  Nan::Set(result, Nan::New(column_key), ByteCountToJS(point.column));
+  Nan::Set(result, Nan::New(data->row_key), Nan::New<Number>(point.row));
+  Nan::Set(result, Nan::New(data->column_key), ByteCountToJS(point.column, encoding));
   return result;
 }
 
-Nan::Maybe<TSPoint> PointFromJS(const Local<Value> &arg) {
+Nan::Maybe<TSPoint> PointFromJS(const Local<Value> &arg, TSInputEncoding encoding) {
   Local<Object> js_point;
   if (!arg->IsObject() || !Nan::To<Object>(arg).ToLocal(&js_point)) {
     Nan::ThrowTypeError("Point must be a {row, column} object");
     return Nan::Nothing<TSPoint>();
   }
 
+  AddonData *data = AddonData::Get();
   Local<Value> js_row;
-  if (!Nan::Get(js_point, Nan::New(row_key)).ToLocal(&js_row)) {
+  if (!Nan::Get(js_point, Nan::New(data->row_key)).ToLocal(&js_row)) {
     Nan::ThrowTypeError("Point must be a {row, column} object");
     return Nan::Nothing<TSPoint>();
   }
 
   Local<Value> js_column;
-  if (!Nan::Get(js_point, Nan::New(column_key)).ToLocal(&js_column)) {
+  if (!Nan::Get(js_point, Nan::New(data->column_key)).ToLocal(&js_column)) {
     Nan::ThrowTypeError("Point must be a {row, column} object");
     return Nan::Nothing<TSPoint>();
   }
@@ -132,7 +133,7 @@ Nan::Maybe<TSPoint> PointFromJS(const Local<Value> &arg) {
   if (!std::isfinite(Nan::To<double>(js_column).FromMaybe(0))) {
     column = UINT32_MAX;
   } else if (js_column->IsNumber()) {
-    column = Nan::To<uint32_t>(js_column).FromMaybe(0) * BYTES_PER_CHARACTER;
+    column = Nan::To<uint32_t>(js_column).FromMaybe(0) * BytesPerCharacter(encoding);
   } else {
     Nan::ThrowTypeError("Point.column must be a number");
     return Nan::Nothing<TSPoint>();
@@ -141,18 +142,38 @@ Nan::Maybe<TSPoint> PointFromJS(const Local<Value> &arg) {
   return Nan::Just<TSPoint>({row, column});
 }
 
-Local<Number> ByteCountToJS(uint32_t byte_count) {
-  return Nan::New<Number>(byte_count / BYTES_PER_CHARACTER);
+Local<Number> ByteCountToJS(uint32_t byte_count, TSInputEncoding encoding) {
+  return Nan::New<Number>(byte_count / BytesPerCharacter(encoding));
 }
 
-Nan::Maybe<uint32_t> ByteCountFromJS(const v8::Local<v8::Value> &arg) {
+Nan::Maybe<uint32_t> ByteCountFromJS(const v8::Local<v8::Value> &arg, TSInputEncoding encoding) {
   auto result = Nan::To<uint32_t>(arg);
   if (!arg->IsNumber()) {
     Nan::ThrowTypeError("Character index must be a number");
     return Nan::Nothing<uint32_t>();
   }
 
-  return Nan::Just<uint32_t>(result.FromJust() * BYTES_PER_CHARACTER);
+  return Nan::Just<uint32_t>(result.FromJust() * BytesPerCharacter(encoding));
+}
+
+Local<Value> EncodingToJS(TSInputEncoding encoding) {
+  return Nan::New(encoding == TSInputEncodingUTF8 ? "utf8" : "utf16").ToLocalChecked();
+}
+
+Nan::Maybe<TSInputEncoding> EncodingFromJS(const Local<Value> &arg) {
+  if (arg->IsString()) {
+    Nan::Utf8String name(arg);
+    std::string encoding(*name, name.length());
+    if (encoding == "utf8" || encoding == "utf-8") {
+      return Nan::Just(TSInputEncodingUTF8);
+    }
+    if (encoding == "utf16" || encoding == "utf16le" || encoding == "utf-16le") {
+      return Nan::Just(TSInputEncodingUTF16);
+    }
+  }
+
+  Nan::ThrowTypeError("Encoding must be either 'utf8' or 'utf16'");
+  return Nan::Nothing<TSInputEncoding>();
 }
 
 }  // namespace node_tree_sitter
@@ -0,0 +1,208 @@
+#include "./mapped_file.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace node_tree_sitter {
+
+using std::shared_ptr;
+using std::string;
+
+#ifdef _WIN32
+
+static string last_error_message() {
+  char *buffer = nullptr;
+  FormatMessageA(
+    FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_FROM_SYSTEM | FORMAT_MESSAGE_IGNORE_INSERTS,
+    nullptr, GetLastError(), 0, reinterpret_cast<char *>(&buffer), 0, nullptr
+  );
+  string result = buffer ? buffer : "Unknown error";
+  LocalFree(buffer);
+  while (!result.empty() && (result.back() == '\n' || result.back() == '\r')) result.pop_back();
+  return result;
+}
+
+shared_ptr<MappedFile> MappedFile::Open(const string &path, string *error) {
+  int wide_length = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, nullptr, 0);
+  std::vector<wchar_t> wide_path(wide_length);
+  MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, wide_path.data(), wide_length);
+
+  HANDLE file = CreateFileW(
+    wide_path.data(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+    nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr
+  );
+  if (file == INVALID_HANDLE_VALUE) {
+    *error = last_error_message();
+    return nullptr;
+  }
+
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size)) {
+    *error = last_error_message();
+    CloseHandle(file);
+    return nullptr;
+  }
+
+  shared_ptr<MappedFile> result(new MappedFile());
+  if (size.QuadPart == 0) {
+    CloseHandle(file);
+    return result;
+  }
+
+  if (static_cast<unsigned long long>(size.QuadPart) <= MAX_COPIED_SIZE) {
+    bool copied = result->Copy(file, static_cast<size_t>(size.QuadPart), error);
+    CloseHandle(file);
+    return copied ? result : nullptr;
+  }
+
+  // The view keeps the mapping object alive, so the mapping handle is not
+  // needed once the file has been mapped.
+  HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (!mapping) {
+    *error = last_error_message();
+    CloseHandle(file);
+    return nullptr;
+  }
+
+  void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  CloseHandle(mapping);
+  if (!view) {
+    *error = last_error_message();
+    CloseHandle(file);
+    return nullptr;
+  }
+
+  // If the file shrank before it was mapped, the end of the view is no
+  // longer backed by it. Read what is left instead.
+  LARGE_INTEGER mapped_size;
+  if (GetFileSizeEx(file, &mapped_size) && mapped_size.QuadPart < size.QuadPart) {
+    UnmapViewOfFile(view);
+    SetFilePointer(file, 0, nullptr, FILE_BEGIN);
+    bool copied = result->Copy(file, static_cast<size_t>(mapped_size.QuadPart), error);
+    CloseHandle(file);
+    return copied ? result : nullptr;
+  }
+  CloseHandle(file);
+
+  result->mapping_ = view;
+  result->data_ = static_cast<const char *>(view);
+  result->length_ = static_cast<size_t>(size.QuadPart);
+  return result;
+}
+
+bool MappedFile::Copy(HANDLE file, size_t size, string *error) {
+  contents_.resize(size);
+  size_t length = 0;
+  while (length < size) {
+    DWORD chunk = static_cast<DWORD>(std::min<size_t>(size - length, MAXDWORD));
+    DWORD bytes_read;
+    if (!ReadFile(file, &contents_[length], chunk, &bytes_read, nullptr)) {
+      *error = last_error_message();
+      return false;
+    }
+    if (bytes_read == 0) break;
+    length += bytes_read;
+  }
+  contents_.resize(length);
+  data_ = contents_.data();
+  length_ = length;
+  return true;
+}
+
+MappedFile::~MappedFile() {
+  if (mapping_) UnmapViewOfFile(mapping_);
+}
+
+#else
+
+shared_ptr<MappedFile> MappedFile::Open(const string &path, string *error) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd == -1) {
+    *error = strerror(errno);
+    return nullptr;
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) == -1) {
+    *error = strerror(errno);
+    close(fd);
+    return nullptr;
+  }
+
+  shared_ptr<MappedFile> result(new MappedFile());
+  if (info.st_size == 0) {
+    close(fd);
+    return result;
+  }
+
+  if (static_cast<size_t>(info.st_size) <= MAX_COPIED_SIZE) {
+    bool copied = result->Copy(fd, info.st_size, error);
+    close(fd);
+    return copied ? result : nullptr;
+  }
+
+  void *mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (mapping == MAP_FAILED) {
+    *error = strerror(errno);
+    close(fd);
+    return nullptr;
+  }
+
+  // If the file shrank before it was mapped, the end of the mapping is no
+  // longer backed by it. Read what is left instead.
+  struct stat mapped_info;
+  if (fstat(fd, &mapped_info) == 0 && mapped_info.st_size < info.st_size) {
+    munmap(mapping, info.st_size);
+    if (lseek(fd, 0, SEEK_SET) == -1) {
+      *error = strerror(errno);
+      close(fd);
+      return nullptr;
+    }
+    bool copied = result->Copy(fd, mapped_info.st_size, error);
+    close(fd);
+    return copied ? result : nullptr;
+  }
+  close(fd);
+
+  result->mapping_ = mapping;
+  result->data_ = static_cast<const char *>(mapping);
+  result->length_ = info.st_size;
+  return result;
+}
+
+bool MappedFile::Copy(int fd, size_t size, string *error) {
+  contents_.resize(size);
+  size_t length = 0;
+  while (length < size) {
+    ssize_t bytes_read = read(fd, &contents_[length], size - length);
+    if (bytes_read == -1) {
+      if (errno == EINTR) continue;
+      *error = strerror(errno);
+      return false;
+    }
+    if (bytes_read == 0) break;
+    length += bytes_read;
+  }
+  contents_.resize(length);
+  data_ = contents_.data();
+  length_ = length;
+  return true;
+}
+
+MappedFile::~MappedFile() {
+  if (mapping_) munmap(mapping_, length_);
+}
+
+#endif
+
+}  // namespace node_tree_sitter
@@ -0,0 +1,46 @@
+#ifndef NODE_TREE_SITTER_MAPPED_FILE_H_
+#define NODE_TREE_SITTER_MAPPED_FILE_H_
+
+#include <memory>
+#include <string>
+
+namespace node_tree_sitter {
+
+// The contents of a whole file, read-only. Trees that were parsed from a
+// file share ownership of it, so that node text can be read from it for as
+// long as the tree is alive.
+//
+// Files up to `MAX_COPIED_SIZE` bytes are copied into memory, which makes
+// them snapshots. Larger files are mapped. A mapping is not a snapshot: if
+// the file is truncated while it is mapped, reading past the new end raises
+// SIGBUS, even with MAP_PRIVATE. Files that shrink while they are being
+// mapped are copied instead.
+class MappedFile {
+ public:
+  static const size_t MAX_COPIED_SIZE = 1024 * 1024;
+
+  static std::shared_ptr<MappedFile> Open(const std::string &path, std::string *error);
+  ~MappedFile();
+
+  const char *data() const { return data_; }
+  size_t length() const { return length_; }
+
+ private:
+  MappedFile() : data_(""), length_(0), mapping_(nullptr) {}
+
+  // Reads up to `size` bytes from the current position into `contents_`.
+#ifdef _WIN32
+  bool Copy(void *file, size_t size, std::string *error);
+#else
+  bool Copy(int fd, size_t size, std::string *error);
+#endif
+
+  const char *data_;
+  size_t length_;
+  void *mapping_;
+  std::string contents_;
+};
+
+}  // namespace node_tree_sitter
+
+#endif  // NODE_TREE_SITTER_MAPPED_FILE_H_
@@ -1,12 +1,22 @@
 #include "./node.h"
 #include <nan.h>
 #include <tree_sitter/api.h>
+#include <cmath>
 #include <vector>
 #include <v8.h>
 #include "./util.h"
+#include "./addon_data.h"
 #include "./conversions.h"
 #include "./tree.h"
 #include "./tree_cursor.h"
+#include "./tree_traversal.h"
+
+#if NODE_MAJOR_VERSION >= 20 && defined(__has_include)
+#if __has_include(<v8-fast-api-calls.h>)
+#include <v8-fast-api-calls.h>
+#define NODE_TREE_SITTER_FAST_API 1
+#endif
+#endif
 
 namespace node_tree_sitter {
 namespace node_methods {
@@ -14,126 +24,113 @@ namespace node_methods {
 using std::vector;
 using namespace v8;
 
-static const uint32_t FIELD_COUNT_PER_NODE = 6;
-
-static uint32_t *transfer_buffer = nullptr;
-static uint32_t transfer_buffer_length = 0;
-static Nan::Persistent<Object> module_exports;
-static TSTreeCursor scratch_cursor = {nullptr, nullptr, {0, 0}};
-
-static inline void setup_transfer_buffer(uint32_t node_count) {
-  uint32_t new_length = node_count * FIELD_COUNT_PER_NODE;
-  if (new_length > transfer_buffer_length) {
-    if (transfer_buffer) {
-      free(transfer_buffer);
-    }
-    transfer_buffer_length = new_length;
-    transfer_buffer = static_cast<uint32_t *>(malloc(transfer_buffer_length * sizeof(uint32_t)));
-
-    #if _MSC_VER && NODE_RUNTIME_ELECTRON && NODE_MODULE_VERSION >= 89
-      // this is a terrible thing we have to do because of https://github.com/electron/electron/issues/29893
-      v8::Local<v8::Object> bufferView;
-      bufferView = node::Buffer::New(Isolate::GetCurrent(), transfer_buffer, 0, transfer_buffer_length * sizeof(uint32_t)).ToLocalChecked();
-      auto js_point_transfer_buffer = node::Buffer::Data(bufferView);
-    #elif V8_MAJOR_VERSION >= 8
-      auto backing_store = ArrayBuffer::NewBackingStore(transfer_buffer, transfer_buffer_length * sizeof(uint32_t), BackingStore::EmptyDeleter, nullptr);
-      auto js_transfer_buffer = ArrayBuffer::New(Isolate::GetCurrent(), std::move(backing_store));
-    #else
-      auto js_transfer_buffer = ArrayBuffer::New(Isolate::GetCurrent(), transfer_buffer, transfer_buffer_length * sizeof(uint32_t));
-    #endif
-
+// Each node is transferred as its slot in the tree's node table. Slots are
+// small integers, and a node has the same slot for as long as JS holds it.
+static const uint32_t FIELD_COUNT_PER_NODE = 1;
+
+// Exposes the current transfer buffer to JS as `nodeTransferArray`.
+static inline void publish_transfer_buffer(AddonData *data) {
+  uint32_t *transfer_buffer = data->transfer_buffer;
+  uint32_t transfer_buffer_length = data->transfer_buffer_length;
+
+  #if _MSC_VER && NODE_RUNTIME_ELECTRON && NODE_MODULE_VERSION >= 89
+    // this is a terrible thing we have to do because of https://github.com/electron/electron/issues/29893
+    v8::Local<v8::Object> bufferView;
+    bufferView = node::Buffer::New(Isolate::GetCurrent(), transfer_buffer, 0, transfer_buffer_length * sizeof(uint32_t)).ToLocalChecked();
+    auto js_point_transfer_buffer = node::Buffer::Data(bufferView);
+  #elif V8_MAJOR_VERSION >= 8
+    auto backing_store = ArrayBuffer::NewBackingStore(transfer_buffer, transfer_buffer_length * sizeof(uint32_t), BackingStore::EmptyDeleter, nullptr);
+    auto js_transfer_buffer = ArrayBuffer::New(Isolate::GetCurrent(), std::move(backing_store));
+  #else
+    auto js_transfer_buffer = ArrayBuffer::New(Isolate::GetCurrent(), transfer_buffer, transfer_buffer_length * sizeof(uint32_t));
+  #endif
+
+  for (auto &exports : data->module_exports) {
     Nan::Set(
-      Nan::New(module_exports),
+      Nan::New(exports),
       Nan::New("nodeTransferArray").ToLocalChecked(),
       Uint32Array::New(js_transfer_buffer, 0, transfer_buffer_length)
     );
   }
 }
 
+static inline void setup_transfer_buffer(uint32_t node_count) {
+  AddonData *data = AddonData::Get();
+  uint32_t new_length = node_count * FIELD_COUNT_PER_NODE;
+  if (new_length > data->transfer_buffer_length) {
+    if (data->transfer_buffer) {
+      free(data->transfer_buffer);
+    }
+    data->transfer_buffer_length = new_length;
+    data->transfer_buffer = static_cast<uint32_t *>(malloc(new_length * sizeof(uint32_t)));
+    publish_transfer_buffer(data);
+  }
+}
+
 static inline bool operator<=(const TSPoint &left, const TSPoint &right) {
   if (left.row < right.row) return true;
   if (left.row > right.row) return false;
   return left.column <= right.column;
 }
 
+void MarshalNullNode() {
+  memset(AddonData::Get()->transfer_buffer, 0, FIELD_COUNT_PER_NODE * sizeof(uint32_t));
+}
+
 static void MarshalNodes(const Nan::FunctionCallbackInfo<Value> &info,
-                         const Tree *tree, const TSNode *nodes, uint32_t node_count) {
+                         Tree *tree, const TSNode *nodes, uint32_t node_count) {
   info.GetReturnValue().Set(GetMarshalNodes(info, tree, nodes, node_count));
 }
 
-void MarshalNode(const Nan::FunctionCallbackInfo<Value> &info, const Tree *tree, TSNode node) {
+void MarshalNode(const Nan::FunctionCallbackInfo<Value> &info, Tree *tree, TSNode node) {
   info.GetReturnValue().Set(GetMarshalNode(info, tree, node));
 }
 
+// Writes the node's slot to `p` and returns the node's type id. JS looks the
+// slot up in the tree's array of nodes, and only creates a new object for a
+// slot that it hasn't seen before.
+static inline Local<Value> MarshalNodeTo(Tree *tree, TSNode node, uint32_t *p) {
+  p[0] = tree->NodeSlot(node);
+  return Nan::New(ts_node_symbol(node));
+}
+
 Local<Value> GetMarshalNodes(const Nan::FunctionCallbackInfo<Value> &info,
-                         const Tree *tree, const TSNode *nodes, uint32_t node_count) {
+                         Tree *tree, const TSNode *nodes, uint32_t node_count) {
   auto result = Nan::New<Array>();
   setup_transfer_buffer(node_count);
-  uint32_t *p = transfer_buffer;
+  uint32_t *p = AddonData::Get()->transfer_buffer;
   for (unsigned i = 0; i < node_count; i++) {
     TSNode node = nodes[i];
-    const auto &cache_entry = tree->cached_nodes_.find(node.id);
-    if (cache_entry == tree->cached_nodes_.end()) {
-      MarshalNodeId(node.id, p);
-      p += 2;
-      *(p++) = node.context[0];
-      *(p++) = node.context[1];
-      *(p++) = node.context[2];
-      *(p++) = node.context[3];
-      if (node.id) {
-        Nan::Set(result, i, Nan::New(ts_node_symbol(node)));
-      } else {
-        Nan::Set(result, i, Nan::Null());
-      }
-    } else {
-      Nan::Set(result, i, Nan::New(cache_entry->second->node));
+    if (!node.id) {
+      Nan::Set(result, i, Nan::Null());
+      continue;
     }
+
+    Nan::Set(result, i, MarshalNodeTo(tree, node, p));
+    p += FIELD_COUNT_PER_NODE;
   }
   return result;
 }
 
-Local<Value> GetMarshalNode(const Nan::FunctionCallbackInfo<Value> &info, const Tree *tree, TSNode node) {
-  const auto &cache_entry = tree->cached_nodes_.find(node.id);
-  if (cache_entry == tree->cached_nodes_.end()) {
-    setup_transfer_buffer(1);
-    uint32_t *p = transfer_buffer;
-    MarshalNodeId(node.id, p);
-    p += 2;
-    *(p++) = node.context[0];
-    *(p++) = node.context[1];
-    *(p++) = node.context[2];
-    *(p++) = node.context[3];
-    if (node.id) {
-      return Nan::New(ts_node_symbol(node));
-    }
-  } else {
-    return Nan::New(cache_entry->second->node);
+Local<Value> GetMarshalNode(const Nan::FunctionCallbackInfo<Value> &info, Tree *tree, TSNode node) {
+  setup_transfer_buffer(1);
+  if (!node.id) {
+    MarshalNullNode();
+    return Nan::Null();
   }
-  return Nan::Null();
-}
-
-void MarshalNullNode() {
-  memset(transfer_buffer, 0, FIELD_COUNT_PER_NODE * sizeof(transfer_buffer[0]));
+  return MarshalNodeTo(tree, node, AddonData::Get()->transfer_buffer);
 }
 
 TSNode UnmarshalNode(const Tree *tree) {
-  TSNode result = {{0, 0, 0, 0}, nullptr, nullptr};
-  result.tree = tree->tree_;
-  if (!result.tree) {
+  if (!tree) {
     Nan::ThrowTypeError("Argument must be a tree");
-    return result;
+    return TSNode{{0, 0, 0, 0}, nullptr, nullptr};
   }
-
-  result.id = UnmarshalNodeId(&transfer_buffer[0]);
-  result.context[0] = transfer_buffer[2];
-  result.context[1] = transfer_buffer[3];
-  result.context[2] = transfer_buffer[4];
-  result.context[3] = transfer_buffer[5];
-  return result;
+  return tree->NodeAt(AddonData::Get()->transfer_buffer[0]);
 }
 
 static void ToString(const Nan::FunctionCallbackInfo<Value> &info) {
-  const Tree *tree = Tree::UnwrapTree(info[0]);
+  Tree *tree = Tree::UnwrapTree(info[0]);
   TSNode node = UnmarshalNode(tree);
   if (node.id) {
     const char *string = ts_node_string(node);
@@ -143,7 +140,7 @@ static void ToString(const Nan::FunctionCallbackInfo<Value> &info) {
 }
 
 static void IsMissing(const Nan::FunctionCallbackInfo<Value> &info) {
-  const Tree *tree = Tree::UnwrapTree(info[0]);
+  Tree *tree = Tree::UnwrapTree(info[0]);
   TSNode node = UnmarshalNode(tree);
   if (node.id) {
     bool result = ts_node_is_missing(node);
@@ -152,7 +149,7 @@ static void IsMissing(const Nan::FunctionCallbackInfo<Value> &info) {
 }
 
 static void HasChanges(const Nan::FunctionCallbackInfo<Value> &info) {
-  const Tree *tree = Tree::UnwrapTree(info[0]);
+  Tree *tree = Tree::UnwrapTree(info[0]);
   TSNode node = UnmarshalNode(tree);
   if (node.id) {
     bool result = ts_node_has_changes(node);
@@ -161,7 +158,7 @@ static void HasChanges(const Nan::FunctionCallbackInfo<Value> &info) {
 }
 
 static void HasError(const Nan::FunctionCallbackInfo<Value> &info) {
-  const Tree *tree = Tree::UnwrapTree(info[0]);
+  Tree *tree = Tree::UnwrapTree(info[0]);
   TSNode node = UnmarshalNode(tree);
   if (node.id) {
     bool result = ts_node_has_error(node);
@@ -170,10 +167,10 @@ static void HasError(const Nan::FunctionCallbackInfo<Value> &info) {
 }
 
 static void FirstNamedChildForIndex(const Nan::FunctionCallbackInfo<Value> &info) {
-  const Tree *tree = Tree::UnwrapTree(info[0]);
+  Tree *tree = Tree::UnwrapTree(info[0]);
   TSNode node = UnmarshalNode(tree);
   if (node.id) {
-    Nan::Maybe<uint32_t> byte = ByteCountFromJS(info[1]);
+    Nan::Maybe<uint32_t> byte = ByteCountFromJS(info[1], tree->encoding_);
     if (byte.IsJust()) {
       MarshalNode(info, tree, ts_node_first_named_child_for_byte(node, byte.FromJust()));
       return;
@@ -183,11 +180,11 @@ static void FirstNamedChildForIndex(const Nan::FunctionCallbackInfo<Value> &info
 }
 
 static void FirstChildForIndex(const Nan::FunctionCallbackInfo<Value> &info) {
-  const Tree *tree = Tree::UnwrapTree(info[0]);
+  Tree *tree = Tree::UnwrapTree(info[0]);
   TSNode node = UnmarshalNode(tree);
 
   if (node.id && info.Length() > 1) {
-    Nan::Maybe<uint32_t> byte = ByteCountFromJS(info[1]);
+    Nan::Maybe<uint32_t> byte = ByteCountFromJS(info[1], tree->encoding_);
     if (byte.IsJust()) {
       MarshalNode(info, tree, ts_node_first_child_for_byte(node, byte.FromJust()));
       return;
@@ -197,12 +194,12 @@ static void FirstChildForIndex(const Nan::FunctionCallbackInfo<Value> &info) {
 }
 
 static void NamedDescendantForIndex(const Nan::FunctionCallbackInfo<Value> &info) {
-  const Tree *tree = Tree::UnwrapTree(info[0]);
+  Tree *tree = Tree::UnwrapTree(info[0]);
   TSNode node = UnmarshalNode(tree);
 
   if (node.id) {
-    Nan::Maybe<uint32_t> maybe_min = ByteCountFromJS(info[1]);
-    Nan::Maybe<uint32_t> maybe_max = ByteCountFromJS(info[2]);
+    Nan::Maybe<uint32_t> maybe_min = ByteCountFromJS(info[1], tree->encoding_);
+    Nan::Maybe<uint32_t> maybe_max = ByteCountFromJS(info[2], tree->encoding_);
     if (maybe_min.IsJust() && maybe_max.IsJust()) {
       uint32_t min = maybe_min.FromJust();
       uint32_t max = maybe_max.FromJust();
@@ -214,12 +211,12 @@ static void NamedDescendantForIndex(const Nan::FunctionCallbackInfo<Value> &info
 }
 
 static void DescendantForIndex(const Nan::FunctionCallbackInfo<Value> &info) {
-  const Tree *tree = Tree::UnwrapTree(info[0]);
+  Tree *tree = Tree::UnwrapTree(info[0]);
   TSNode node = UnmarshalNode(tree);
 
   if (node.id) {
-    Nan::Maybe<uint32_t> maybe_min = ByteCountFromJS(info[1]);
-    Nan::Maybe<uint32_t> maybe_max = ByteCountFromJS(info[2]);
+    Nan::Maybe<uint32_t> maybe_min = ByteCountFromJS(info[1], tree->encoding_);
+    Nan::Maybe<uint32_t> maybe_max = ByteCountFromJS(info[2], tree->encoding_);
     if (maybe_min.IsJust() && maybe_max.IsJust()) {
       uint32_t min = maybe_min.FromJust();
       uint32_t max = maybe_max.FromJust();
@@ -231,12 +228,12 @@ static void DescendantForIndex(const Nan::FunctionCallbackInfo<Value> &info) {
 }
 
 static void NamedDescendantForPosition(const Nan::FunctionCallbackInfo<Value> &info) {
-  const Tree *tree = Tree::UnwrapTree(info[0]);
+  Tree *tree = Tree::UnwrapTree(info[0]);
   TSNode node = UnmarshalNode(tree);
 
   if (node.id) {
-    Nan::Maybe<TSPoint> maybe_min = PointFromJS(info[1]);
-    Nan::Maybe<TSPoint> maybe_max = PointFromJS(info[2]);
+    Nan::Maybe<TSPoint> maybe_min = PointFromJS(info[1], tree->encoding_);
+    Nan::Maybe<TSPoint> maybe_max = PointFromJS(info[2], tree->encoding_);
     if (maybe_min.IsJust() && maybe_max.IsJust()) {
       TSPoint min = maybe_min.FromJust();
       TSPoint max = maybe_max.FromJust();
@@ -248,12 +245,12 @@ static void NamedDescendantForPosition(const Nan::FunctionCallbackInfo<Value> &i
 }
 
 static void DescendantForPosition(const Nan::FunctionCallbackInfo<Value> &info) {
-  const Tree *tree = Tree::UnwrapTree(info[0]);
+  Tree *tree = Tree::UnwrapTree(info[0]);
   TSNode node = UnmarshalNode(tree);
 
   if (node.id) {
-    Nan::Maybe<TSPoint> maybe_min = PointFromJS(info[1]);
-    Nan::Maybe<TSPoint> maybe_max = PointFromJS(info[2]);
+    Nan::Maybe<TSPoint> maybe_min = PointFromJS(info[1], tree->encoding_);
+    Nan::Maybe<TSPoint> maybe_max = PointFromJS(info[2], tree->encoding_);
     if (maybe_min.IsJust() && maybe_max.IsJust()) {
       TSPoint min = maybe_min.FromJust();
       TSPoint max = maybe_max.FromJust();
@@ -265,7 +262,7 @@ static void DescendantForPosition(const Nan::FunctionCallbackInfo<Value> &info)
 }
 
 static void Type(const Nan::FunctionCallbackInfo<Value> &info) {
-  const Tree *tree = Tree::UnwrapTree(info[0]);
+  Tree *tree = Tree::UnwrapTree(info[0]);
   TSNode node = UnmarshalNode(tree);
 
   if (node.id) {
@@ -275,7 +272,7 @@ static void Type(const Nan::FunctionCallbackInfo<Value> &info) {
 }
 
 static void TypeId(const Nan::FunctionCallbackInfo<Value> &info) {
-  const Tree *tree = Tree::UnwrapTree(info[0]);
+  Tree *tree = Tree::UnwrapTree(info[0]);
   TSNode node = UnmarshalNode(tree);
 
   if (node.id) {
@@ -285,7 +282,7 @@ static void TypeId(const Nan::FunctionCallbackInfo<Value> &info) {
 }
 
 static void IsNamed(const Nan::FunctionCallbackInfo<Value> &info) {
-  const Tree *tree = Tree::UnwrapTree(info[0]);
+  Tree *tree = Tree::UnwrapTree(info[0]);
   TSNode node = UnmarshalNode(tree);
 
   if (node.id) {
@@ -295,45 +292,43 @@ static void IsNamed(const Nan::FunctionCallbackInfo<Value> &info) {
 }
 
 static void StartIndex(const Nan::FunctionCallbackInfo<Value> &info) {
-  const Tree *tree = Tree::UnwrapTree(info[0]);
+  Tree *tree = Tree::UnwrapTree(info[0]);
   TSNode node = UnmarshalNode(tree);
 
   if (node.id) {
-    int32_t result = ts_node_start_byte(node) / 2;
-    info.GetReturnValue().Set(Nan::New<Integer>(result));
+    info.GetReturnValue().Set(ByteCountToJS(ts_node_start_byte(node), tree->encoding_));
   }
 }
 
 static void EndIndex(const Nan::FunctionCallbackInfo<Value> &info) {
-  const Tree *tree = Tree::UnwrapTree(info[0]);
+  Tree *tree = Tree::UnwrapTree(info[0]);
   TSNode node = UnmarshalNode(tree);
 
   if (node.id) {
-    int32_t result = ts_node_end_byte(node) / 2;
-    info.GetReturnValue().Set(Nan::New<Integer>(result));
+    info.GetReturnValue().Set(ByteCountToJS(ts_node_end_byte(node), tree->encoding_));
   }
 }
 
 static void StartPosition(const Nan::FunctionCallbackInfo<Value> &info) {
-  const Tree *tree = Tree::UnwrapTree(info[0]);
+  Tree *tree = Tree::UnwrapTree(info[0]);
   TSNode node = UnmarshalNode(tree);
 
   if (node.id) {
-    TransferPoint(ts_node_start_point(node));
+    TransferPoint(ts_node_start_point(node), tree->encoding_);
   }
 }
 
 static void EndPosition(const Nan::FunctionCallbackInfo<Value> &info) {
-  const Tree *tree = Tree::UnwrapTree(info[0]);
+  Tree *tree = Tree::UnwrapTree(info[0]);
   TSNode node = UnmarshalNode(tree);
 
   if (node.id) {
-    TransferPoint(ts_node_end_point(node));
+    TransferPoint(ts_node_end_point(node), tree->encoding_);
   }
 }
 
 static void Child(const Nan::FunctionCallbackInfo<Value> &info) {
-  const Tree *tree = Tree::UnwrapTree(info[0]);
+  Tree *tree = Tree::UnwrapTree(info[0]);
   TSNode node = UnmarshalNode(tree);
 
   if (node.id) {
@@ -349,7 +344,7 @@ static void Child(const Nan::FunctionCallbackInfo<Value> &info) {
 }
 
 static void NamedChild(const Nan::FunctionCallbackInfo<Value> &info) {
-  const Tree *tree = Tree::UnwrapTree(info[0]);
+  Tree *tree = Tree::UnwrapTree(info[0]);
   TSNode node = UnmarshalNode(tree);
 
   if (node.id) {
@@ -365,7 +360,7 @@ static void NamedChild(const Nan::FunctionCallbackInfo<Value> &info) {
 }
 
 static void ChildCount(const Nan::FunctionCallbackInfo<Value> &info) {
-  const Tree *tree = Tree::UnwrapTree(info[0]);
+  Tree *tree = Tree::UnwrapTree(info[0]);
   TSNode node = UnmarshalNode(tree);
 
   if (node.id) {
@@ -374,7 +369,7 @@ static void ChildCount(const Nan::FunctionCallbackInfo<Value> &info) {
 }
 
 static void NamedChildCount(const Nan::FunctionCallbackInfo<Value> &info) {
-  const Tree *tree = Tree::UnwrapTree(info[0]);
+  Tree *tree = Tree::UnwrapTree(info[0]);
   TSNode node = UnmarshalNode(tree);
 
   if (node.id) {
@@ -383,7 +378,7 @@ static void NamedChildCount(const Nan::FunctionCallbackInfo<Value> &info) {
 }
 
 static void FirstChild(const Nan::FunctionCallbackInfo<Value> &info) {
-  const Tree *tree = Tree::UnwrapTree(info[0]);
+  Tree *tree = Tree::UnwrapTree(info[0]);
   TSNode node = UnmarshalNode(tree);
   if (node.id) {
     MarshalNode(info, tree, ts_node_child(node, 0));
@@ -393,7 +388,7 @@ static void FirstChild(const Nan::FunctionCallbackInfo<Value> &info) {
 }
 
 static void FirstNamedChild(const Nan::FunctionCallbackInfo<Value> &info) {
-  const Tree *tree = Tree::UnwrapTree(info[0]);
+  Tree *tree = Tree::UnwrapTree(info[0]);
   TSNode node = UnmarshalNode(tree);
   if (node.id) {
     MarshalNode(info, tree, ts_node_named_child(node, 0));
@@ -403,7 +398,7 @@ static void FirstNamedChild(const Nan::FunctionCallbackInfo<Value> &info) {
 }
 
 static void LastChild(const Nan::FunctionCallbackInfo<Value> &info) {
-  const Tree *tree = Tree::UnwrapTree(info[0]);
+  Tree *tree = Tree::UnwrapTree(info[0]);
   TSNode node = UnmarshalNode(tree);
   if (node.id) {
     uint32_t child_count = ts_node_child_count(node);
@@ -416,7 +411,7 @@ static void LastChild(const Nan::FunctionCallbackInfo<Value> &info) {
 }
 
 static void LastNamedChild(const Nan::FunctionCallbackInfo<Value> &info) {
-  const Tree *tree = Tree::UnwrapTree(info[0]);
+  Tree *tree = Tree::UnwrapTree(info[0]);
   TSNode node = UnmarshalNode(tree);
   if (node.id) {
     uint32_t child_count = ts_node_named_child_count(node);
@@ -429,7 +424,7 @@ static void LastNamedChild(const Nan::FunctionCallbackInfo<Value> &info) {
 }
 
 static void Parent(const Nan::FunctionCallbackInfo<Value> &info) {
-  const Tree *tree = Tree::UnwrapTree(info[0]);
+  Tree *tree = Tree::UnwrapTree(info[0]);
   TSNode node = UnmarshalNode(tree);
   if (node.id) {
     MarshalNode(info, tree, ts_node_parent(node));
@@ -439,7 +434,7 @@ static void Parent(const Nan::FunctionCallbackInfo<Value> &info) {
 }
 
 static void NextSibling(const Nan::FunctionCallbackInfo<Value> &info) {
-  const Tree *tree = Tree::UnwrapTree(info[0]);
+  Tree *tree = Tree::UnwrapTree(info[0]);
   TSNode node = UnmarshalNode(tree);
   if (node.id) {
     MarshalNode(info, tree, ts_node_next_sibling(node));
@@ -449,7 +444,7 @@ static void NextSibling(const Nan::FunctionCallbackInfo<Value> &info) {
 }
 
 static void NextNamedSibling(const Nan::FunctionCallbackInfo<Value> &info) {
-  const Tree *tree = Tree::UnwrapTree(info[0]);
+  Tree *tree = Tree::UnwrapTree(info[0]);
   TSNode node = UnmarshalNode(tree);
   if (node.id) {
     MarshalNode(info, tree, ts_node_next_named_sibling(node));
@@ -459,7 +454,7 @@ static void NextNamedSibling(const Nan::FunctionCallbackInfo<Value> &info) {
 }
 
 static void PreviousSibling(const Nan::FunctionCallbackInfo<Value> &info) {
-  const Tree *tree = Tree::UnwrapTree(info[0]);
+  Tree *tree = Tree::UnwrapTree(info[0]);
   TSNode node = UnmarshalNode(tree);
   if (node.id) {
     MarshalNode(info, tree, ts_node_prev_sibling(node));
@@ -469,7 +464,7 @@ static void PreviousSibling(const Nan::FunctionCallbackInfo<Value> &info) {
 }
 
 static void PreviousNamedSibling(const Nan::FunctionCallbackInfo<Value> &info) {
-  const Tree *tree = Tree::UnwrapTree(info[0]);
+  Tree *tree = Tree::UnwrapTree(info[0]);
   TSNode node = UnmarshalNode(tree);
   if (node.id) {
     MarshalNode(info, tree, ts_node_prev_named_sibling(node));
@@ -537,43 +532,45 @@ bool symbol_set_from_js(SymbolSet *symbols, const Local<Value> &value, const TSL
 }
 
 static void Children(const Nan::FunctionCallbackInfo<Value> &info) {
-  const Tree *tree = Tree::UnwrapTree(info[0]);
+  Tree *tree = Tree::UnwrapTree(info[0]);
   TSNode node = UnmarshalNode(tree);
   if (!node.id) return;
 
   vector<TSNode> result;
-  ts_tree_cursor_reset(&scratch_cursor, node);
-  if (ts_tree_cursor_goto_first_child(&scratch_cursor)) {
+  TSTreeCursor *scratch_cursor = &AddonData::Get()->scratch_cursor;
+  ts_tree_cursor_reset(scratch_cursor, node);
+  if (ts_tree_cursor_goto_first_child(scratch_cursor)) {
     do {
-      TSNode child = ts_tree_cursor_current_node(&scratch_cursor);
+      TSNode child = ts_tree_cursor_current_node(scratch_cursor);
       result.push_back(child);
-    } while (ts_tree_cursor_goto_next_sibling(&scratch_cursor));
+    } while (ts_tree_cursor_goto_next_sibling(scratch_cursor));
   }
 
   MarshalNodes(info, tree, result.data(), result.size());
 }
 
 static void NamedChildren(const Nan::FunctionCallbackInfo<Value> &info) {
-  const Tree *tree = Tree::UnwrapTree(info[0]);
+  Tree *tree = Tree::UnwrapTree(info[0]);
   TSNode node = UnmarshalNode(tree);
   if (!node.id) return;
 
   vector<TSNode> result;
-  ts_tree_cursor_reset(&scratch_cursor, node);
-  if (ts_tree_cursor_goto_first_child(&scratch_cursor)) {
+  TSTreeCursor *scratch_cursor = &AddonData::Get()->scratch_cursor;
+  ts_tree_cursor_reset(scratch_cursor, node);
+  if (ts_tree_cursor_goto_first_child(scratch_cursor)) {
     do {
-      TSNode child = ts_tree_cursor_current_node(&scratch_cursor);
+      TSNode child = ts_tree_cursor_current_node(scratch_cursor);
       if (ts_node_is_named(child)) {
         result.push_back(child);
       }
-    } while (ts_tree_cursor_goto_next_sibling(&scratch_cursor));
+    } while (ts_tree_cursor_goto_next_sibling(scratch_cursor));
   }
 
   MarshalNodes(info, tree, result.data(), result.size());
 }
 
 static void DescendantsOfType(const Nan::FunctionCallbackInfo<Value> &info) {
-  const Tree *tree = Tree::UnwrapTree(info[0]);
+  Tree *tree = Tree::UnwrapTree(info[0]);
   TSNode node = UnmarshalNode(tree);
   if (!node.id) return;
 
@@ -584,29 +581,30 @@ static void DescendantsOfType(const Nan::FunctionCallbackInfo<Value> &info) {
   TSPoint end_point = {UINT32_MAX, UINT32_MAX};
 
   if (info.Length() > 2 && info[2]->IsObject()) {
-    auto maybe_start_point = PointFromJS(info[2]);
+    auto maybe_start_point = PointFromJS(info[2], tree->encoding_);
     if (maybe_start_point.IsNothing()) return;
     start_point = maybe_start_point.FromJust();
   }
 
   if (info.Length() > 3 && info[3]->IsObject()) {
-    auto maybe_end_point = PointFromJS(info[3]);
+    auto maybe_end_point = PointFromJS(info[3], tree->encoding_);
     if (maybe_end_point.IsNothing()) return;
     end_point = maybe_end_point.FromJust();
   }
 
   vector<TSNode> found;
-  ts_tree_cursor_reset(&scratch_cursor, node);
+  TSTreeCursor *scratch_cursor = &AddonData::Get()->scratch_cursor;
+  ts_tree_cursor_reset(scratch_cursor, node);
   auto already_visited_children = false;
   while (true) {
-    TSNode descendant = ts_tree_cursor_current_node(&scratch_cursor);
+    TSNode descendant = ts_tree_cursor_current_node(scratch_cursor);
 
     if (!already_visited_children) {
       if (ts_node_end_point(descendant) <= start_point) {
-        if (ts_tree_cursor_goto_next_sibling(&scratch_cursor)) {
+        if (ts_tree_cursor_goto_next_sibling(scratch_cursor)) {
           already_visited_children = false;
         } else {
-          if (!ts_tree_cursor_goto_parent(&scratch_cursor)) break;
+          if (!ts_tree_cursor_goto_parent(scratch_cursor)) break;
           already_visited_children = true;
         }
         continue;
@@ -618,19 +616,19 @@ static void DescendantsOfType(const Nan::FunctionCallbackInfo<Value> &info) {
         found.push_back(descendant);
       }
 
-      if (ts_tree_cursor_goto_first_child(&scratch_cursor)) {
+      if (ts_tree_cursor_goto_first_child(scratch_cursor)) {
         already_visited_children = false;
-      } else if (ts_tree_cursor_goto_next_sibling(&scratch_cursor)) {
+      } else if (ts_tree_cursor_goto_next_sibling(scratch_cursor)) {
         already_visited_children = false;
       } else {
-        if (!ts_tree_cursor_goto_parent(&scratch_cursor)) break;
+        if (!ts_tree_cursor_goto_parent(scratch_cursor)) break;
         already_visited_children = true;
       }
     } else {
-      if (ts_tree_cursor_goto_next_sibling(&scratch_cursor)) {
+      if (ts_tree_cursor_goto_next_sibling(scratch_cursor)) {
         already_visited_children = false;
       } else {
-        if (!ts_tree_cursor_goto_parent(&scratch_cursor)) break;
+        if (!ts_tree_cursor_goto_parent(scratch_cursor)) break;
       }
     }
   }
@@ -639,7 +637,7 @@ static void DescendantsOfType(const Nan::FunctionCallbackInfo<Value> &info) {
 }
 
 static void ChildNodesForFieldId(const Nan::FunctionCallbackInfo<Value> &info) {
-  const Tree *tree = Tree::UnwrapTree(info[0]);
+  Tree *tree = Tree::UnwrapTree(info[0]);
   TSNode node = UnmarshalNode(tree);
   if (!node.id) return;
 
@@ -651,21 +649,22 @@ static void ChildNodesForFieldId(const Nan::FunctionCallbackInfo<Value> &info) {
   uint32_t field_id = maybe_field_id.FromJust();
 
   vector<TSNode> result;
-  ts_tree_cursor_reset(&scratch_cursor, node);
-  if (ts_tree_cursor_goto_first_child(&scratch_cursor)) {
+  TSTreeCursor *scratch_cursor = &AddonData::Get()->scratch_cursor;
+  ts_tree_cursor_reset(scratch_cursor, node);
+  if (ts_tree_cursor_goto_first_child(scratch_cursor)) {
     do {
-      TSNode child = ts_tree_cursor_current_node(&scratch_cursor);
-      if (ts_tree_cursor_current_field_id(&scratch_cursor) == field_id) {
+      TSNode child = ts_tree_cursor_current_node(scratch_cursor);
+      if (ts_tree_cursor_current_field_id(scratch_cursor) == field_id) {
         result.push_back(child);
       }
-    } while (ts_tree_cursor_goto_next_sibling(&scratch_cursor));
+    } while (ts_tree_cursor_goto_next_sibling(scratch_cursor));
   }
 
   MarshalNodes(info, tree, result.data(), result.size());
 }
 
 static void ChildNodeForFieldId(const Nan::FunctionCallbackInfo<Value> &info) {
-  const Tree *tree = Tree::UnwrapTree(info[0]);
+  Tree *tree = Tree::UnwrapTree(info[0]);
   TSNode node = UnmarshalNode(tree);
 
   if (node.id) {
@@ -682,7 +681,7 @@ static void ChildNodeForFieldId(const Nan::FunctionCallbackInfo<Value> &info) {
 }
 
 static void Closest(const Nan::FunctionCallbackInfo<Value> &info) {
-  const Tree *tree = Tree::UnwrapTree(info[0]);
+  Tree *tree = Tree::UnwrapTree(info[0]);
   TSNode node = UnmarshalNode(tree);
   if (!node.id) return;
 
@@ -703,12 +702,211 @@ static void Closest(const Nan::FunctionCallbackInfo<Value> &info) {
 }
 
 static void Walk(const Nan::FunctionCallbackInfo<Value> &info) {
-  const Tree *tree = Tree::UnwrapTree(info[0]);
+  Tree *tree = Tree::UnwrapTree(info[0]);
   TSNode node = UnmarshalNode(tree);
   TSTreeCursor cursor = ts_tree_cursor_new(node);
-  info.GetReturnValue().Set(TreeCursor::NewInstance(cursor));
+  info.GetReturnValue().Set(TreeCursor::NewInstance(cursor, tree->encoding_));
 }
 
+static void Traverse(const Nan::FunctionCallbackInfo<Value> &info) {
+  Tree *tree = Tree::UnwrapTree(info[0]);
+  TSNode node = UnmarshalNode(tree);
+  if (!node.id) return;
+
+  TraversalFilter filter = {{}, false, UINT32_MAX, 0, UINT32_MAX};
+  if (!info[1]->IsUndefined()) {
+    SymbolSet symbols;
+    if (!symbol_set_from_js(&symbols, info[1], ts_tree_language(node.tree))) return;
+    filter.types.resize(UINT16_MAX + 1);
+    for (TSSymbol symbol : symbols.symbols) {
+      filter.types[symbol] = true;
+    }
+  }
+
+  filter.named_only = Nan::To<bool>(info[2]).FromMaybe(false);
+
+  if (!info[3]->IsUndefined()) {
+    // Written so that NaN fails the check too. Depths past UINT32_MAX,
+    // including Infinity, are the same as no limit.
+    double max_depth = info[3]->IsNumber() ? info[3].As<v8::Number>()->Value() : -1;
+    if (!(max_depth >= 0) || max_depth != std::floor(max_depth)) {
+      Nan::ThrowTypeError("maxDepth must be an integer");
+      return;
+    }
+    filter.max_depth = max_depth < UINT32_MAX ? static_cast<uint32_t>(max_depth) : UINT32_MAX;
+  }
+
+  if (!info[4]->IsUndefined()) {
+    auto maybe_start = ByteCountFromJS(info[4], tree->encoding_);
+    if (maybe_start.IsNothing()) return;
+    filter.start_byte = maybe_start.FromJust();
+  }
+
+  if (!info[5]->IsUndefined()) {
+    auto maybe_end = ByteCountFromJS(info[5], tree->encoding_);
+    if (maybe_end.IsNothing()) return;
+    filter.end_byte = maybe_end.FromJust();
+  }
+
+  info.GetReturnValue().Set(TreeTraversal::NewInstance(tree, node, filter));
+}
+
+uint32_t NodeFlags(TSNode node) {
+  return
+    (ts_node_is_named(node) ? NodeFlagNamed : 0) |
+    (ts_node_is_missing(node) ? NodeFlagMissing : 0) |
+    (ts_node_symbol(node) == static_cast<TSSymbol>(-1) ? NodeFlagError : 0);
+}
+
+// The properties that `readMany` can read. Positions take two values, a row
+// and a column; every other property takes one. The values for each node
+// are written in the order of these bits.
+enum ReadField : uint32_t {
+  ReadTypeId = 1,
+  ReadStartIndex = 2,
+  ReadEndIndex = 4,
+  ReadStartPosition = 8,
+  ReadEndPosition = 16,
+  ReadChildCount = 32,
+  ReadNamedChildCount = 64,
+  ReadFlags = 128,
+};
+
+static uint32_t read_field_count(uint32_t mask) {
+  uint32_t count = 0;
+  for (uint32_t bit = ReadTypeId; bit <= ReadFlags; bit <<= 1) {
+    if (mask & bit) count += (bit == ReadStartPosition || bit == ReadEndPosition) ? 2 : 1;
+  }
+  return count;
+}
+
+static void ReadMany(const Nan::FunctionCallbackInfo<Value> &info) {
+  Tree *tree = Tree::UnwrapTree(info[0]);
+  if (!tree) {
+    Nan::ThrowTypeError("Argument must be a tree");
+    return;
+  }
+
+  if (!info[1]->IsUint32Array() || !info[3]->IsUint32Array()) {
+    Nan::ThrowTypeError("Nodes and output must be Uint32Arrays");
+    return;
+  }
+
+  uint32_t mask = Nan::To<uint32_t>(info[2]).FromMaybe(0);
+  Nan::TypedArrayContents<uint32_t> slots(info[1]);
+  Nan::TypedArrayContents<uint32_t> out(info[3]);
+  size_t stride = read_field_count(mask);
+  if (out.length() < slots.length() * stride) {
+    Nan::ThrowRangeError("The output array is too small");
+    return;
+  }
+
+  uint32_t bytes_per_character = BytesPerCharacter(tree->encoding_);
+  uint32_t *p = *out;
+  for (size_t i = 0; i < slots.length(); i++) {
+    TSNode node = tree->NodeAt((*slots)[i]);
+    if (!node.id) {
+      Nan::ThrowRangeError("Invalid node");
+      return;
+    }
+
+    if (mask & ReadTypeId) *p++ = ts_node_symbol(node);
+    if (mask & ReadStartIndex) *p++ = ts_node_start_byte(node) / bytes_per_character;
+    if (mask & ReadEndIndex) *p++ = ts_node_end_byte(node) / bytes_per_character;
+    if (mask & ReadStartPosition) {
+      TSPoint point = ts_node_start_point(node);
+      *p++ = point.row;
+      *p++ = point.column / bytes_per_character;
+    }
+    if (mask & ReadEndPosition) {
+      TSPoint point = ts_node_end_point(node);
+      *p++ = point.row;
+      *p++ = point.column / bytes_per_character;
+    }
+    if (mask & ReadChildCount) *p++ = ts_node_child_count(node);
+    if (mask & ReadNamedChildCount) *p++ = ts_node_named_child_count(node);
+    if (mask & ReadFlags) *p++ = NodeFlags(node);
+  }
+
+  info.GetReturnValue().Set(Nan::New<Number>(p - *out));
+}
+
+#ifdef NODE_TREE_SITTER_FAST_API
+
+// The hottest scalar getters are also registered as V8 fast API calls, which
+// optimized code can call without setting up a full callback frame. They
+// read the node from the transfer buffer, just like the Nan callbacks, which
+// are still used by unoptimized code. A fast call cannot throw, so an invalid
+// tree or a null node reads as zero.
+static inline TSNode FastUnmarshalNode(Local<Value> js_tree, Tree **tree_out) {
+  Nan::HandleScope scope;
+  Tree *tree = Tree::UnwrapTree(js_tree);
+  *tree_out = tree;
+  if (!tree) return TSNode{{0, 0, 0, 0}, nullptr, nullptr};
+  return tree->NodeAt(AddonData::Get()->transfer_buffer[0]);
+}
+
+static uint32_t FastStartIndex(Local<Object> receiver, Local<Value> js_tree) {
+  Tree *tree;
+  TSNode node = FastUnmarshalNode(js_tree, &tree);
+  if (!node.id) return 0;
+  return ts_node_start_byte(node) / BytesPerCharacter(tree->encoding_);
+}
+
+static uint32_t FastEndIndex(Local<Object> receiver, Local<Value> js_tree) {
+  Tree *tree;
+  TSNode node = FastUnmarshalNode(js_tree, &tree);
+  if (!node.id) return 0;
+  return ts_node_end_byte(node) / BytesPerCharacter(tree->encoding_);
+}
+
+static uint32_t FastTypeId(Local<Object> receiver, Local<Value> js_tree) {
+  Tree *tree;
+  TSNode node = FastUnmarshalNode(js_tree, &tree);
+  return node.id ? ts_node_symbol(node) : 0;
+}
+
+static uint32_t FastChildCount(Local<Object> receiver, Local<Value> js_tree) {
+  Tree *tree;
+  TSNode node = FastUnmarshalNode(js_tree, &tree);
+  return node.id ? ts_node_child_count(node) : 0;
+}
+
+static bool FastIsNamed(Local<Object> receiver, Local<Value> js_tree) {
+  Tree *tree;
+  TSNode node = FastUnmarshalNode(js_tree, &tree);
+  return node.id && ts_node_is_named(node);
+}
+
+static bool FastHasError(Local<Object> receiver, Local<Value> js_tree) {
+  Tree *tree;
+  TSNode node = FastUnmarshalNode(js_tree, &tree);
+  return node.id && ts_node_has_error(node);
+}
+
+static const CFunction fast_start_index = CFunction::Make(FastStartIndex);
+static const CFunction fast_end_index = CFunction::Make(FastEndIndex);
+static const CFunction fast_type_id = CFunction::Make(FastTypeId);
+static const CFunction fast_child_count = CFunction::Make(FastChildCount);
+static const CFunction fast_is_named = CFunction::Make(FastIsNamed);
+static const CFunction fast_has_error = CFunction::Make(FastHasError);
+
+// Calls a Nan callback from a plain V8 callback, which is what a function
+// template with a fast path needs as its slow path.
+template <Nan::FunctionCallback callback>
+static void SlowCallback(const v8::FunctionCallbackInfo<Value> &info) {
+  Nan::FunctionCallbackInfo<Value> nan_info(info, Local<Value>());
+  callback(nan_info);
+}
+
+struct FastFunctionPair {
+  const char *name;
+  v8::FunctionCallback callback;
+  const CFunction *fast_callback;
+};
+
+#endif  // NODE_TREE_SITTER_FAST_API
+
 void Init(Local<Object> exports) {
   Local<Object> result = Nan::New<Object>();
 
@@ -747,6 +945,8 @@ void Init(Local<Object> exports) {
     {"hasError", HasError},
     {"descendantsOfType", DescendantsOfType},
     {"walk", Walk},
+    {"traverse", Traverse},
+    {"readMany", ReadMany},
     {"closest", Closest},
     {"childNodeForFieldId", ChildNodeForFieldId},
     {"childNodesForFieldId", ChildNodesForFieldId},
@@ -760,8 +960,41 @@ void Init(Local<Object> exports) {
     );
   }
 
-  module_exports.Reset(exports);
-  setup_transfer_buffer(1);
+#ifdef NODE_TREE_SITTER_FAST_API
+  FastFunctionPair fast_methods[] = {
+    {"startIndex", SlowCallback<StartIndex>, &fast_start_index},
+    {"endIndex", SlowCallback<EndIndex>, &fast_end_index},
+    {"typeId", SlowCallback<TypeId>, &fast_type_id},
+    {"childCount", SlowCallback<ChildCount>, &fast_child_count},
+    {"isNamed", SlowCallback<IsNamed>, &fast_is_named},
+    {"hasError", SlowCallback<HasError>, &fast_has_error},
+  };
+
+  for (size_t i = 0; i < length_of_array(fast_methods); i++) {
+    Local<FunctionTemplate> tpl = FunctionTemplate::New(
+      Isolate::GetCurrent(),
+      fast_methods[i].callback,
+      Local<Value>(),
+      Local<Signature>(),
+      1,
+      ConstructorBehavior::kThrow,
+      SideEffectType::kHasNoSideEffect,
+      fast_methods[i].fast_callback
+    );
+    Nan::Set(
+      result,
+      Nan::New(fast_methods[i].name).ToLocalChecked(),
+      Nan::GetFunction(tpl).ToLocalChecked()
+    );
+  }
+#endif
+
+  AddonData *data = AddonData::Get();
+  if (data->transfer_buffer) {
+    publish_transfer_buffer(data);
+  } else {
+    setup_transfer_buffer(1);
+  }
 
   Nan::Set(exports, Nan::New("NodeMethods").ToLocalChecked(), result);
 }
@@ -12,23 +12,20 @@ using namespace v8;
 namespace node_tree_sitter {
 namespace node_methods {
 
+// The bits that summarize a node in `Tree.toFlatArrays` and `readMany`.
+enum NodeFlag : uint32_t {
+  NodeFlagNamed = 1,
+  NodeFlagMissing = 2,
+  NodeFlagError = 4,
+};
+
 void Init(v8::Local<v8::Object>);
-void MarshalNode(const Nan::FunctionCallbackInfo<v8::Value> &info, const Tree *, TSNode);
-Local<Value> GetMarshalNode(const Nan::FunctionCallbackInfo<Value> &info, const Tree *tree, TSNode node);
-Local<Value> GetMarshalNodes(const Nan::FunctionCallbackInfo<Value> &info, const Tree *tree, const TSNode *nodes, uint32_t node_count);
+uint32_t NodeFlags(TSNode);
+void MarshalNode(const Nan::FunctionCallbackInfo<v8::Value> &info, Tree *, TSNode);
+Local<Value> GetMarshalNode(const Nan::FunctionCallbackInfo<Value> &info, Tree *tree, TSNode node);
+Local<Value> GetMarshalNodes(const Nan::FunctionCallbackInfo<Value> &info, Tree *tree, const TSNode *nodes, uint32_t node_count);
 TSNode UnmarshalNode(const Tree *tree);
 
-static inline const void *UnmarshalNodeId(const uint32_t *buffer) {
-  const void *result;
-  memcpy(&result, buffer, sizeof(result));
-  return result;
-}
-
-static inline void MarshalNodeId(const void *id, uint32_t *buffer) {
-  memset(buffer, 0, sizeof(uint64_t));
-  memcpy(buffer, &id, sizeof(id));
-}
-
 }  // namespace node_methods
 }  // namespace node_tree_sitter
 
@@ -1,12 +1,17 @@
 #include "./parser.h"
+#include <memory>
 #include <string>
 #include <vector>
 #include <climits>
+#include <algorithm>
 #include <v8.h>
 #include <nan.h>
+#include "./addon_data.h"
+#include "./buffer_input.h"
 #include "./conversions.h"
 #include "./language.h"
 #include "./logger.h"
+#include "./mapped_file.h"
 #include "./tree.h"
 #include "./util.h"
 #include "text-buffer-snapshot-wrapper.h"
@@ -18,12 +23,12 @@ using namespace v8;
 using std::vector;
 using std::pair;
 
-Nan::Persistent<Function> Parser::constructor;
 
 class CallbackInput {
  public:
-  CallbackInput(v8::Local<v8::Function> callback, v8::Local<v8::Value> js_buffer_size)
+  CallbackInput(v8::Local<v8::Function> callback, v8::Local<v8::Value> js_buffer_size, TSInputEncoding encoding)
     : callback(callback),
+      encoding(encoding),
       byte_offset(0),
       partial_string_offset(0) {
     uint32_t buffer_size = Nan::To<uint32_t>(js_buffer_size).FromMaybe(0);
@@ -34,7 +39,7 @@ class CallbackInput {
   TSInput Input() {
     TSInput result;
     result.payload = (void *)this;
-    result.encoding = TSInputEncodingUTF16;
+    result.encoding = encoding;
     result.read = Read;
     return result;
   }
@@ -50,6 +55,7 @@ class CallbackInput {
     }
 
     *bytes_read = 0;
+    reader->chunk.Reset();
     Local<String> result;
     uint32_t start = 0;
     if (reader->partial_string_offset) {
@@ -57,18 +63,33 @@ class CallbackInput {
       start = reader->partial_string_offset;
     } else {
       Local<Function> callback = Nan::New(reader->callback);
-      uint32_t utf16_unit = byte / 2;
-      Local<Value> argv[2] = { Nan::New<Number>(utf16_unit), PointToJS(position) };
+      uint32_t character_offset = byte / BytesPerCharacter(reader->encoding);
+      Local<Value> argv[2] = { Nan::New<Number>(character_offset), PointToJS(position, reader->encoding) };
       TryCatch try_catch(Isolate::GetCurrent());
       auto maybe_result_value = Nan::Call(callback, callback->CreationContext()->Global(), 2, argv);
       if (try_catch.HasCaught()) return nullptr;
 
       Local<Value> result_value;
       if (!maybe_result_value.ToLocal(&result_value)) return nullptr;
+
+      // Buffers are assumed to already contain text in the parser's encoding,
+      // so they can be handed to tree-sitter without copying. The buffer is
+      // retained until the next read, when tree-sitter is done with it.
+      if (node::Buffer::HasInstance(result_value)) {
+        reader->chunk.Reset(result_value.As<Object>());
+        *bytes_read = node::Buffer::Length(result_value);
+        reader->byte_offset += *bytes_read;
+        return node::Buffer::Data(result_value);
+      }
+
       if (!result_value->IsString()) return nullptr;
       if (!Nan::To<String>(result_value).ToLocal(&result)) return nullptr;
     }
 
+    if (reader->encoding == TSInputEncodingUTF8) {
+      return reader->ReadUTF8(result, bytes_read);
+    }
+
     int utf16_units_read = result->Write(
 
       // Nan doesn't wrap this functionality
@@ -97,11 +118,187 @@ class CallbackInput {
     return (const char *)reader->buffer.data();
   }
 
+  // V8 can't encode a string as UTF8 starting from an arbitrary offset, so
+  // strings are encoded in one piece rather than in `buffer_size` chunks.
+  const char *ReadUTF8(Local<String> string, uint32_t *bytes_read) {
+    #if NODE_MAJOR_VERSION >= 12
+      Isolate *isolate = Isolate::GetCurrent();
+      size_t length = string->Utf8Length(isolate);
+    #else
+      size_t length = string->Utf8Length();
+    #endif
+
+    if (utf8_buffer.size() < length) utf8_buffer.resize(length);
+    string->WriteUtf8(
+
+      // Nan doesn't wrap this functionality
+      #if NODE_MAJOR_VERSION >= 12
+        isolate,
+      #endif
+
+      &utf8_buffer[0],
+      length,
+      nullptr,
+      String::NO_NULL_TERMINATION
+    );
+
+    *bytes_read = length;
+    byte_offset += length;
+    return utf8_buffer.data();
+  }
+
   Nan::Persistent<v8::Function> callback;
+  TSInputEncoding encoding;
   std::vector<uint16_t> buffer;
+  std::string utf8_buffer;
   size_t byte_offset;
   Nan::Persistent<v8::String> partial_string;
   size_t partial_string_offset;
+  Nan::Persistent<v8::Object> chunk;
+};
+
+// Reads a JS string without calling back into JS. External strings are read
+// in place. Other strings are flattened into native memory once, keeping
+// one-byte strings one byte per character where the encoding allows it.
+class StringInput {
+ public:
+  StringInput(v8::Local<v8::String> string, TSInputEncoding encoding)
+    : encoding_(encoding),
+      one_byte_data_(nullptr),
+      two_byte_data_(nullptr),
+      length_(0) {
+
+    // Nan doesn't wrap this functionality
+    #if NODE_MAJOR_VERSION >= 12
+      #define ISOLATE_ARG Isolate::GetCurrent(),
+    #else
+      #define ISOLATE_ARG
+    #endif
+
+    if (encoding == TSInputEncodingUTF16) {
+      if (auto resource = string->GetExternalStringResource()) {
+        two_byte_data_ = resource->data();
+        length_ = resource->length();
+      } else if (auto resource = string->GetExternalOneByteStringResource()) {
+        one_byte_data_ = reinterpret_cast<const uint8_t *>(resource->data());
+        length_ = resource->length();
+      } else if (string->IsOneByte()) {
+        length_ = string->Length();
+        one_byte_buffer_.resize(length_);
+        string->WriteOneByte(ISOLATE_ARG one_byte_buffer_.data(), 0, length_, String::NO_NULL_TERMINATION);
+        one_byte_data_ = one_byte_buffer_.data();
+      } else {
+        length_ = string->Length();
+        two_byte_buffer_.resize(length_);
+        string->Write(ISOLATE_ARG two_byte_buffer_.data(), 0, length_, String::NO_NULL_TERMINATION);
+        two_byte_data_ = two_byte_buffer_.data();
+      }
+      if (one_byte_data_) widen_buffer_.resize(32 * 1024);
+      return;
+    }
+
+    // One-byte strings are Latin1, which is only valid UTF8 if it is ASCII.
+    if (auto resource = string->GetExternalOneByteStringResource()) {
+      one_byte_data_ = reinterpret_cast<const uint8_t *>(resource->data());
+      length_ = resource->length();
+    } else if (string->IsOneByte()) {
+      length_ = string->Length();
+      one_byte_buffer_.resize(length_);
+      string->WriteOneByte(ISOLATE_ARG one_byte_buffer_.data(), 0, length_, String::NO_NULL_TERMINATION);
+      one_byte_data_ = one_byte_buffer_.data();
+    }
+
+    if (one_byte_data_) {
+      bool is_ascii = true;
+      for (size_t i = 0; i < length_; i++) {
+        if (one_byte_data_[i] & 0x80) {
+          is_ascii = false;
+          break;
+        }
+      }
+      if (is_ascii) return;
+    }
+
+    one_byte_buffer_.clear();
+    #if NODE_MAJOR_VERSION >= 12
+      length_ = string->Utf8Length(Isolate::GetCurrent());
+    #else
+      length_ = string->Utf8Length();
+    #endif
+    one_byte_buffer_.resize(length_);
+    string->WriteUtf8(
+      ISOLATE_ARG
+      reinterpret_cast<char *>(one_byte_buffer_.data()),
+      length_,
+      nullptr,
+      String::NO_NULL_TERMINATION
+    );
+    one_byte_data_ = one_byte_buffer_.data();
+
+    #undef ISOLATE_ARG
+  }
+
+  TSInput input() {
+    return TSInput{this, Read, encoding_};
+  }
+
+ private:
+  static const char *Read(void *payload, uint32_t byte, TSPoint position, uint32_t *bytes_read) {
+    auto self = static_cast<StringInput *>(payload);
+    size_t index = byte / BytesPerCharacter(self->encoding_);
+
+    if (index >= self->length_) {
+      *bytes_read = 0;
+      return "";
+    }
+
+    if (self->two_byte_data_) {
+      *bytes_read = 2 * (self->length_ - index);
+      return reinterpret_cast<const char *>(self->two_byte_data_ + index);
+    }
+
+    if (self->encoding_ == TSInputEncodingUTF8) {
+      *bytes_read = self->length_ - index;
+      return reinterpret_cast<const char *>(self->one_byte_data_ + index);
+    }
+
+    size_t count = std::min(self->length_ - index, self->widen_buffer_.size());
+    const uint8_t *source = self->one_byte_data_ + index;
+    for (size_t i = 0; i < count; i++) {
+      self->widen_buffer_[i] = source[i];
+    }
+    *bytes_read = 2 * count;
+    return reinterpret_cast<const char *>(self->widen_buffer_.data());
+  }
+
+  TSInputEncoding encoding_;
+  const uint8_t *one_byte_data_;
+  const uint16_t *two_byte_data_;
+  size_t length_;
+  vector<uint8_t> one_byte_buffer_;
+  vector<uint16_t> two_byte_buffer_;
+  vector<uint16_t> widen_buffer_;
+};
+
+// The input of a time-sliced parse, which has to outlive the call to `parse`
+// that started it.
+struct Parser::PendingParse {
+  PendingParse(TSInputEncoding encoding, uint32_t time_slice, TSTree *old_tree)
+    : encoding(encoding), time_slice(time_slice), old_tree(old_tree) {}
+
+  ~PendingParse() {
+    if (old_tree) ts_tree_delete(old_tree);
+    js_input.Reset();
+  }
+
+  TSInput input;
+  TSInputEncoding encoding;
+  uint32_t time_slice;
+  TSTree *old_tree;
+  Nan::Persistent<Value> js_input;
+  std::unique_ptr<BufferInput> buffer_input;
+  std::unique_ptr<StringInput> string_input;
+  std::unique_ptr<CallbackInput> callback_input;
 };
 
 class TextBufferInput {
@@ -110,7 +307,15 @@ public:
     : slices_(slices),
       byte_offset(0),
       slice_index_(0),
-      slice_offset_(0) {}
+      slice_offset_(0) {
+    slice_starts_.reserve(slices->size() + 1);
+    uint32_t total_length = 0;
+    for (auto &slice : *slices) {
+      slice_starts_.push_back(total_length);
+      total_length += slice.second;
+    }
+    slice_starts_.push_back(total_length);
+  }
 
   TSInput input() {
     return TSInput{this, Read, TSInputEncodingUTF16};
@@ -120,16 +325,15 @@ private:
   void seek(uint32_t byte_offset) {
     this->byte_offset = byte_offset;
 
-    uint32_t total_length = 0;
+    // Find the last slice that starts at or before the goal. Empty slices
+    // share their start with the slice after them, so they are skipped.
     uint32_t goal_index = byte_offset / 2;
-    for (unsigned i = 0, n = this->slices_->size(); i < n; i++) {
-      uint32_t next_total_length = total_length + this->slices_->at(i).second;
-      if (next_total_length > goal_index) {
-        this->slice_index_ = i;
-        this->slice_offset_ = goal_index - total_length;
-        return;
-      }
-      total_length = next_total_length;
+    auto next_start = std::upper_bound(slice_starts_.begin(), slice_starts_.end(), goal_index);
+    uint32_t index = next_start - slice_starts_.begin() - 1;
+    if (index < this->slices_->size()) {
+      this->slice_index_ = index;
+      this->slice_offset_ = goal_index - slice_starts_[index];
+      return;
     }
 
     this->slice_index_ = this->slices_->size();
@@ -156,6 +360,7 @@ private:
   }
 
   const vector<pair<const char16_t *, uint32_t>> *slices_;
+  vector<uint32_t> slice_starts_;
   uint32_t byte_offset;
   uint32_t slice_index_;
   uint32_t slice_offset_;
@@ -170,9 +375,15 @@ void Parser::Init(Local<Object> exports) {
   FunctionPair methods[] = {
     {"getLogger", GetLogger},
     {"setLogger", SetLogger},
+    {"getEncoding", GetEncoding},
+    {"setEncoding", SetEncoding},
     {"setLanguage", SetLanguage},
     {"printDotGraphs", PrintDotGraphs},
     {"parse", Parse},
+    {"resumeParse", ResumeParse},
+    {"cancel", Cancel},
+    {"parseAsync", ParseAsync},
+    {"parseFile", ParseFile},
     {"parseTextBuffer", ParseTextBuffer},
     {"parseTextBufferSync", ParseTextBufferSync},
   };
@@ -181,16 +392,28 @@ void Parser::Init(Local<Object> exports) {
     Nan::SetPrototypeMethod(tpl, methods[i].name, methods[i].callback);
   }
 
-  constructor.Reset(Nan::Persistent<Function>(Nan::GetFunction(tpl).ToLocalChecked()));
-  Nan::Set(exports, class_name, Nan::New(constructor));
+  AddonData *data = AddonData::Get();
+  AddonData::SetOnce(data->parser_constructor, Nan::GetFunction(tpl).ToLocalChecked());
+  Nan::Set(exports, class_name, Nan::New(data->parser_constructor));
   Nan::Set(exports, Nan::New("LANGUAGE_VERSION").ToLocalChecked(), Nan::New<Number>(TREE_SITTER_LANGUAGE_VERSION));
 }
 
-Parser::Parser() : parser_(ts_parser_new()), is_parsing_async_(false) {}
+static_assert(
+  sizeof(std::atomic<size_t>) == sizeof(size_t),
+  "The cancellation flag must have the layout that tree-sitter expects"
+);
+
+Parser::Parser() :
+  parser_(ts_parser_new()),
+  encoding_(TSInputEncodingUTF16),
+  is_parsing_async_(false),
+  cancellation_flag_(0) {
+  ts_parser_set_cancellation_flag(parser_, reinterpret_cast<const size_t *>(&cancellation_flag_));
+}
 
 Parser::~Parser() { ts_parser_delete(parser_); }
 
-static bool handle_included_ranges(TSParser *parser, Local<Value> arg) {
+static bool handle_included_ranges(TSParser *parser, Local<Value> arg, TSInputEncoding encoding) {
   uint32_t last_included_range_end = 0;
   if (arg->IsArray()) {
     auto js_included_ranges = Local<Array>::Cast(arg);
@@ -198,7 +421,7 @@ static bool handle_included_ranges(TSParser *parser, Local<Value> arg) {
     for (unsigned i = 0; i < js_included_ranges->Length(); i++) {
       Local<Value> range_value;
       if (!Nan::Get(js_included_ranges, i).ToLocal(&range_value)) return false;
-      auto maybe_range = RangeFromJS(range_value);
+      auto maybe_range = RangeFromJS(range_value, encoding);
       if (!maybe_range.IsJust()) return false;
       auto range = maybe_range.FromJust();
       if (range.start_byte < last_included_range_end) {
@@ -223,7 +446,7 @@ void Parser::New(const Nan::FunctionCallbackInfo<Value> &info) {
     info.GetReturnValue().Set(info.This());
   } else {
     Local<Object> self;
-    MaybeLocal<Object> maybe_self = Nan::New(constructor)->NewInstance(Nan::GetCurrentContext());
+    MaybeLocal<Object> maybe_self = Nan::New(AddonData::Get()->parser_constructor)->NewInstance(Nan::GetCurrentContext());
     if (maybe_self.ToLocal(&self)) {
       info.GetReturnValue().Set(self);
     } else {
@@ -253,62 +476,322 @@ void Parser::Parse(const Nan::FunctionCallbackInfo<Value> &info) {
     return;
   }
 
-  if (!info[0]->IsFunction()) {
-    Nan::ThrowTypeError("Input must be a function");
+  const char *buffer_data = nullptr;
+  size_t buffer_length = 0;
+  bool is_buffer = buffer_contents(info[0], &buffer_data, &buffer_length);
+  if (!is_buffer && !info[0]->IsString() && !info[0]->IsFunction()) {
+    Nan::ThrowTypeError("Input must be a string, a buffer or a function");
     return;
   }
 
-  Local<Function> callback = Local<Function>::Cast(info[0]);
+  TSInputEncoding encoding = parser->encoding_;
+  if (info.Length() > 4 && !info[4]->IsUndefined()) {
+    auto maybe_encoding = EncodingFromJS(info[4]);
+    if (maybe_encoding.IsNothing()) return;
+    encoding = maybe_encoding.FromJust();
+  }
 
   Local<Object> js_old_tree;
   const TSTree *old_tree = nullptr;
   if (info.Length() > 1 && !info[1]->IsNull() && !info[1]->IsUndefined() && Nan::To<Object>(info[1]).ToLocal(&js_old_tree)) {
-    const Tree *tree = Tree::UnwrapTree(js_old_tree);
+    Tree *tree = Tree::UnwrapTree(js_old_tree);
     if (!tree) {
       Nan::ThrowTypeError("Second argument must be a tree");
       return;
     }
+    if (tree->encoding_ != encoding) {
+      Nan::ThrowError("The old tree was parsed with a different encoding");
+      return;
+    }
     old_tree = tree->tree_;
   }
 
   Local<Value> buffer_size = Nan::Null();
   if (info.Length() > 2) buffer_size = info[2];
 
-  if (!handle_included_ranges(parser->parser_, info[3])) return;
+  uint32_t time_slice = 0;
+  if (info.Length() > 5 && !info[5]->IsUndefined()) {
+    auto maybe_time_slice = Nan::To<uint32_t>(info[5]);
+    if (maybe_time_slice.IsNothing() || maybe_time_slice.FromJust() == 0) {
+      Nan::ThrowTypeError("The `timeSliceMicros` option must be a positive integer.");
+      return;
+    }
+    time_slice = maybe_time_slice.FromJust();
+  }
+
+  if (!handle_included_ranges(parser->parser_, info[3], encoding)) return;
 
-  CallbackInput callback_input(callback, buffer_size);
-  TSTree *tree = ts_parser_parse(parser->parser_, old_tree, callback_input.Input());
-  Local<Value> result = Tree::NewInstance(tree);
-  info.GetReturnValue().Set(result);
+  if (!time_slice || !ts_parser_language(parser->parser_)) {
+    TSTree *tree;
+    if (is_buffer) {
+      BufferInput buffer_input(buffer_data, buffer_length, encoding);
+      tree = ts_parser_parse(parser->parser_, old_tree, buffer_input.input());
+    } else if (info[0]->IsString()) {
+      StringInput string_input(Local<String>::Cast(info[0]), encoding);
+      tree = ts_parser_parse(parser->parser_, old_tree, string_input.input());
+    } else {
+      CallbackInput callback_input(Local<Function>::Cast(info[0]), buffer_size, encoding);
+      tree = ts_parser_parse(parser->parser_, old_tree, callback_input.Input());
+    }
+    Local<Value> result = Tree::NewInstance(tree, encoding);
+    info.GetReturnValue().Set(result);
+    return;
+  }
+
+  auto pending = new PendingParse(encoding, time_slice, old_tree ? ts_tree_copy(old_tree) : nullptr);
+  pending->js_input.Reset(info[0]);
+  if (is_buffer) {
+    pending->buffer_input.reset(new BufferInput(buffer_data, buffer_length, encoding));
+    pending->input = pending->buffer_input->input();
+  } else if (info[0]->IsString()) {
+    pending->string_input.reset(new StringInput(Local<String>::Cast(info[0]), encoding));
+    pending->input = pending->string_input->input();
+  } else {
+    pending->callback_input.reset(new CallbackInput(Local<Function>::Cast(info[0]), buffer_size, encoding));
+    pending->input = pending->callback_input->Input();
+  }
+
+  // The parser stays in use until the last slice has finished, and the
+  // input is kept alive until then.
+  parser->pending_parse_.reset(pending);
+  parser->is_parsing_async_ = true;
+  info.GetReturnValue().Set(ParseSlice(parser));
 }
 
+void Parser::ResumeParse(const Nan::FunctionCallbackInfo<Value> &info) {
+  Parser *parser = ObjectWrap::Unwrap<Parser>(info.This());
+  if (!parser->pending_parse_) {
+    Nan::ThrowError("No parse is in progress");
+    return;
+  }
+  info.GetReturnValue().Set(ParseSlice(parser));
+}
+
+// Runs one slice of a time-sliced parse. Returns `undefined` if the time ran
+// out, in which case tree-sitter keeps its partial state and the next slice
+// picks up where this one stopped.
+Local<Value> Parser::ParseSlice(Parser *parser) {
+  PendingParse *pending = parser->pending_parse_.get();
+  ts_parser_set_timeout_micros(parser->parser_, pending->time_slice);
+  TSTree *tree = ts_parser_parse(parser->parser_, pending->old_tree, pending->input);
+  ts_parser_set_timeout_micros(parser->parser_, 0);
+
+  if (!tree) {
+    if (!parser->cancellation_flag_) return Nan::Undefined();
+    ts_parser_reset(parser->parser_);
+  }
+
+  TSInputEncoding encoding = pending->encoding;
+  parser->pending_parse_.reset();
+  parser->is_parsing_async_ = false;
+  parser->cancellation_flag_ = 0;
+  return Tree::NewInstance(tree, encoding);
+}
+
+// Runs a parse on the libuv threadpool. The input must not touch V8 from its
+// read callback; any JS value that it reads from is pinned by the caller.
+template <typename InputType>
 class ParseWorker : public Nan::AsyncWorker {
   Parser *parser_;
+  TSTree *old_tree_;
   TSTree *new_tree_;
-  TextBufferInput *input_;
+  InputType *input_;
+  TSInputEncoding encoding_;
 
 public:
-  ParseWorker(Nan::Callback *callback, Parser *parser, TextBufferInput *input) :
-    AsyncWorker(callback, "tree-sitter.parseTextBuffer"),
+  ParseWorker(Nan::Callback *callback, const char *resource_name, Parser *parser,
+              InputType *input, TSTree *old_tree, TSInputEncoding encoding) :
+    AsyncWorker(callback, resource_name),
     parser_(parser),
+    old_tree_(old_tree),
     new_tree_(nullptr),
-    input_(input) {}
+    input_(input),
+    encoding_(encoding) {}
+
+  ~ParseWorker() {
+    delete input_;
+    if (old_tree_) ts_tree_delete(old_tree_);
+  }
 
   void Execute() {
     TSLogger logger = ts_parser_logger(parser_->parser_);
     ts_parser_set_logger(parser_->parser_, TSLogger{0, 0});
-    new_tree_ = ts_parser_parse(parser_->parser_, nullptr, input_->input());
+    new_tree_ = ts_parser_parse(parser_->parser_, old_tree_, input_->input());
     ts_parser_set_logger(parser_->parser_, logger);
+
+    // A cancelled parse leaves its partial state in the parser. Discard it,
+    // so that the next parse starts from the beginning.
+    if (!new_tree_) ts_parser_reset(parser_->parser_);
   }
 
   void HandleOKCallback() {
     parser_->is_parsing_async_ = false;
-    delete input_;
-    Local<Value> argv[] = {Tree::NewInstance(new_tree_)};
+    parser_->cancellation_flag_ = 0;
+    Local<Value> argv[] = {Tree::NewInstance(new_tree_, encoding_)};
+    callback->Call(1, argv, async_resource);
+  }
+};
+
+void Parser::ParseAsync(const Nan::FunctionCallbackInfo<Value> &info) {
+  Parser *parser = ObjectWrap::Unwrap<Parser>(info.This());
+  if (parser->is_parsing_async_) {
+    Nan::ThrowError("Parser is in use");
+    return;
+  }
+
+  const char *buffer_data = nullptr;
+  size_t buffer_length = 0;
+  bool is_buffer = buffer_contents(info[1], &buffer_data, &buffer_length);
+  if (!is_buffer && !info[1]->IsString()) {
+    Nan::ThrowTypeError("Input must be a string or a buffer");
+    return;
+  }
+
+  TSInputEncoding encoding = parser->encoding_;
+  if (info.Length() > 4 && !info[4]->IsUndefined()) {
+    auto maybe_encoding = EncodingFromJS(info[4]);
+    if (maybe_encoding.IsNothing()) return;
+    encoding = maybe_encoding.FromJust();
+  }
+
+  Local<Object> js_old_tree;
+  const TSTree *old_tree = nullptr;
+  if (info.Length() > 2 && !info[2]->IsNull() && !info[2]->IsUndefined() && Nan::To<Object>(info[2]).ToLocal(&js_old_tree)) {
+    Tree *tree = Tree::UnwrapTree(js_old_tree);
+    if (!tree) {
+      Nan::ThrowTypeError("Second argument must be a tree");
+      return;
+    }
+    if (tree->encoding_ != encoding) {
+      Nan::ThrowError("The old tree was parsed with a different encoding");
+      return;
+    }
+    old_tree = tree->tree_;
+  }
+
+  if (!handle_included_ranges(parser->parser_, info[3], encoding)) return;
+
+  // The old tree is copied so that it can be edited while the parse runs.
+  // Strings are flattened into native memory here, on the main thread, and
+  // buffers are read in place, so the input value is kept alive until the
+  // worker is done with it.
+  auto callback = new Nan::Callback(info[0].As<Function>());
+  TSTree *old_tree_copy = old_tree ? ts_tree_copy(old_tree) : nullptr;
+  Nan::AsyncWorker *worker;
+  if (is_buffer) {
+    worker = new ParseWorker<BufferInput>(
+      callback,
+      "tree-sitter.parseAsync",
+      parser,
+      new BufferInput(buffer_data, buffer_length, encoding),
+      old_tree_copy,
+      encoding
+    );
+  } else {
+    worker = new ParseWorker<StringInput>(
+      callback,
+      "tree-sitter.parseAsync",
+      parser,
+      new StringInput(Local<String>::Cast(info[1]), encoding),
+      old_tree_copy,
+      encoding
+    );
+  }
+  worker->SaveToPersistent("input", info[1]);
+
+  parser->is_parsing_async_ = true;
+  Nan::AsyncQueueWorker(worker);
+}
+
+class ParseFileWorker : public Nan::AsyncWorker {
+  Parser *parser_;
+  std::string path_;
+  TSInputEncoding encoding_;
+  std::shared_ptr<MappedFile> file_;
+  TSTree *new_tree_;
+
+public:
+  ParseFileWorker(Nan::Callback *callback, Parser *parser, const std::string &path, TSInputEncoding encoding) :
+    AsyncWorker(callback, "tree-sitter.parseFile"),
+    parser_(parser),
+    path_(path),
+    encoding_(encoding),
+    new_tree_(nullptr) {}
+
+  void Execute() {
+    std::string error;
+    file_ = MappedFile::Open(path_, &error);
+    if (!file_) {
+      SetErrorMessage(("Could not read file " + path_ + ": " + error).c_str());
+      return;
+    }
+
+    BufferInput input(file_->data(), file_->length(), encoding_);
+    TSLogger logger = ts_parser_logger(parser_->parser_);
+    ts_parser_set_logger(parser_->parser_, TSLogger{0, 0});
+    new_tree_ = ts_parser_parse(parser_->parser_, nullptr, input.input());
+    ts_parser_set_logger(parser_->parser_, logger);
+    if (!new_tree_) ts_parser_reset(parser_->parser_);
+  }
+
+  void HandleOKCallback() {
+    parser_->is_parsing_async_ = false;
+    parser_->cancellation_flag_ = 0;
+    Local<Value> argv[] = {Nan::Null(), Tree::NewInstance(new_tree_, encoding_, file_)};
+    callback->Call(2, argv, async_resource);
+  }
+
+  void HandleErrorCallback() {
+    parser_->is_parsing_async_ = false;
+    parser_->cancellation_flag_ = 0;
+    Local<Value> argv[] = {Nan::Error(ErrorMessage())};
     callback->Call(1, argv, async_resource);
   }
 };
 
+void Parser::ParseFile(const Nan::FunctionCallbackInfo<Value> &info) {
+  Parser *parser = ObjectWrap::Unwrap<Parser>(info.This());
+  if (parser->is_parsing_async_) {
+    Nan::ThrowError("Parser is in use");
+    return;
+  }
+
+  if (!info[0]->IsString()) {
+    Nan::ThrowTypeError("File path must be a string");
+    return;
+  }
+
+  TSInputEncoding encoding = parser->encoding_;
+  if (!info[1]->IsUndefined()) {
+    auto maybe_encoding = EncodingFromJS(info[1]);
+    if (maybe_encoding.IsNothing()) return;
+    encoding = maybe_encoding.FromJust();
+  }
+
+  if (!handle_included_ranges(parser->parser_, info[2], encoding)) return;
+
+  std::string path = *Nan::Utf8String(info[0]);
+
+  // With a callback, the file is mapped and parsed on the threadpool.
+  if (info[3]->IsFunction()) {
+    auto callback = new Nan::Callback(info[3].As<Function>());
+    parser->is_parsing_async_ = true;
+    Nan::AsyncQueueWorker(new ParseFileWorker(callback, parser, path, encoding));
+    return;
+  }
+
+  std::string error;
+  auto file = MappedFile::Open(path, &error);
+  if (!file) {
+    Nan::ThrowError(("Could not read file " + path + ": " + error).c_str());
+    return;
+  }
+
+  BufferInput input(file->data(), file->length(), encoding);
+  TSTree *tree = ts_parser_parse(parser->parser_, nullptr, input.input());
+  info.GetReturnValue().Set(Tree::NewInstance(tree, encoding, file));
+}
+
 void Parser::ParseTextBuffer(const Nan::FunctionCallbackInfo<Value> &info) {
   Parser *parser = ObjectWrap::Unwrap<Parser>(info.This());
   if (parser->is_parsing_async_) {
@@ -319,15 +802,19 @@ void Parser::ParseTextBuffer(const Nan::FunctionCallbackInfo<Value> &info) {
   Local<Object> js_old_tree;
   const TSTree *old_tree = nullptr;
   if (info.Length() > 2 && info[2]->IsObject() && Nan::To<Object>(info[2]).ToLocal(&js_old_tree)) {
-    const Tree *tree = Tree::UnwrapTree(js_old_tree);
+    Tree *tree = Tree::UnwrapTree(js_old_tree);
     if (!tree) {
       Nan::ThrowTypeError("Second argument must be a tree");
       return;
     }
+    if (tree->encoding_ != TSInputEncodingUTF16) {
+      Nan::ThrowError("The old tree was parsed with a different encoding");
+      return;
+    }
     old_tree = tree->tree_;
   }
 
-  if (!handle_included_ranges(parser->parser_, info[3])) return;
+  if (!handle_included_ranges(parser->parser_, info[3], TSInputEncodingUTF16)) return;
 
   auto snapshot = Nan::ObjectWrap::Unwrap<TextBufferSnapshotWrapper>(info[1].As<Object>());
   auto input = new TextBufferInput(snapshot->slices());
@@ -362,7 +849,7 @@ void Parser::ParseTextBuffer(const Nan::FunctionCallbackInfo<Value> &info) {
 
     if (result) {
       delete input;
-      Local<Value> argv[] = {Tree::NewInstance(result)};
+      Local<Value> argv[] = {Tree::NewInstance(result, TSInputEncodingUTF16)};
       auto callback = info[0].As<Function>();
       Nan::Call(callback, callback->CreationContext()->Global(), 1, argv);
       return;
@@ -371,10 +858,13 @@ void Parser::ParseTextBuffer(const Nan::FunctionCallbackInfo<Value> &info) {
 
   auto callback = new Nan::Callback(info[0].As<Function>());
   parser->is_parsing_async_ = true;
-  Nan::AsyncQueueWorker(new ParseWorker(
+  Nan::AsyncQueueWorker(new ParseWorker<TextBufferInput>(
     callback,
+    "tree-sitter.parseTextBuffer",
     parser,
-    input
+    input,
+    old_tree ? ts_tree_copy(old_tree) : nullptr,
+    TSInputEncodingUTF16
   ));
 }
 
@@ -388,20 +878,32 @@ void Parser::ParseTextBufferSync(const Nan::FunctionCallbackInfo<Value> &info) {
   Local<Object> js_old_tree;
   const TSTree *old_tree = nullptr;
   if (info.Length() > 1 && info[1]->IsObject() && Nan::To<Object>(info[1]).ToLocal(&js_old_tree)) {
-    const Tree *tree = Tree::UnwrapTree(js_old_tree);
+    Tree *tree = Tree::UnwrapTree(js_old_tree);
     if (!tree) {
       Nan::ThrowTypeError("Second argument must be a tree");
       return;
     }
+    if (tree->encoding_ != TSInputEncodingUTF16) {
+      Nan::ThrowError("The old tree was parsed with a different encoding");
+      return;
+    }
     old_tree = ts_tree_copy(tree->tree_);
   }
 
-  if (!handle_included_ranges(parser->parser_, info[2])) return;
+  if (!handle_included_ranges(parser->parser_, info[2], TSInputEncodingUTF16)) return;
 
   auto snapshot = Nan::ObjectWrap::Unwrap<TextBufferSnapshotWrapper>(info[0].As<Object>());
   TextBufferInput input(snapshot->slices());
   TSTree *result = ts_parser_parse(parser->parser_, old_tree, input.input());
-  info.GetReturnValue().Set(Tree::NewInstance(result));
+  info.GetReturnValue().Set(Tree::NewInstance(result, TSInputEncodingUTF16));
+}
+
+void Parser::Cancel(const Nan::FunctionCallbackInfo<Value> &info) {
+  Parser *parser = ObjectWrap::Unwrap<Parser>(info.This());
+
+  // Only a parse that runs in the background or in time slices can be
+  // interrupted. The flag is cleared again when that parse finishes.
+  if (parser->is_parsing_async_) parser->cancellation_flag_ = 1;
 }
 
 void Parser::GetLogger(const Nan::FunctionCallbackInfo<Value> &info) {
@@ -439,6 +941,25 @@ void Parser::SetLogger(const Nan::FunctionCallbackInfo<Value> &info) {
   info.GetReturnValue().Set(info.This());
 }
 
+void Parser::GetEncoding(const Nan::FunctionCallbackInfo<Value> &info) {
+  Parser *parser = ObjectWrap::Unwrap<Parser>(info.This());
+  info.GetReturnValue().Set(EncodingToJS(parser->encoding_));
+}
+
+void Parser::SetEncoding(const Nan::FunctionCallbackInfo<Value> &info) {
+  Parser *parser = ObjectWrap::Unwrap<Parser>(info.This());
+  if (parser->is_parsing_async_) {
+    Nan::ThrowError("Parser is in use");
+    return;
+  }
+
+  auto maybe_encoding = EncodingFromJS(info[0]);
+  if (maybe_encoding.IsNothing()) return;
+  parser->encoding_ = maybe_encoding.FromJust();
+
+  info.GetReturnValue().Set(info.This());
+}
+
 void Parser::PrintDotGraphs(const Nan::FunctionCallbackInfo<Value> &info) {
   Parser *parser = ObjectWrap::Unwrap<Parser>(info.This());
   if (parser->is_parsing_async_) {
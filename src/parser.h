@@ -1,6 +1,8 @@
 #ifndef NODE_TREE_SITTER_PARSER_H_
 #define NODE_TREE_SITTER_PARSER_H_
 
+#include <atomic>
+#include <memory>
 #include <v8.h>
 #include <nan.h>
 #include <node_object_wrap.h>
@@ -13,9 +15,15 @@ class Parser : public Nan::ObjectWrap {
   static void Init(v8::Local<v8::Object> exports);
 
   TSParser *parser_;
+  TSInputEncoding encoding_;
   bool is_parsing_async_;
+  std::atomic<size_t> cancellation_flag_;
 
  private:
+  struct PendingParse;
+
+  std::unique_ptr<PendingParse> pending_parse_;
+
   explicit Parser();
   ~Parser();
 
@@ -23,12 +31,18 @@ class Parser : public Nan::ObjectWrap {
   static void SetLanguage(const Nan::FunctionCallbackInfo<v8::Value> &);
   static void GetLogger(const Nan::FunctionCallbackInfo<v8::Value> &);
   static void SetLogger(const Nan::FunctionCallbackInfo<v8::Value> &);
+  static void GetEncoding(const Nan::FunctionCallbackInfo<v8::Value> &);
+  static void SetEncoding(const Nan::FunctionCallbackInfo<v8::Value> &);
   static void Parse(const Nan::FunctionCallbackInfo<v8::Value> &);
+  static void ResumeParse(const Nan::FunctionCallbackInfo<v8::Value> &);
+  static v8::Local<v8::Value> ParseSlice(Parser *);
+  static void Cancel(const Nan::FunctionCallbackInfo<v8::Value> &);
+  static void ParseAsync(const Nan::FunctionCallbackInfo<v8::Value> &);
+  static void ParseFile(const Nan::FunctionCallbackInfo<v8::Value> &);
   static void ParseTextBuffer(const Nan::FunctionCallbackInfo<v8::Value> &);
   static void ParseTextBufferSync(const Nan::FunctionCallbackInfo<v8::Value> &);
   static void PrintDotGraphs(const Nan::FunctionCallbackInfo<v8::Value> &);
 
-  static Nan::Persistent<v8::Function> constructor;
 };
 
 }  // namespace node_tree_sitter
@@ -0,0 +1,489 @@
+#include "./parser_pool.h"
+#include <node.h>
+#include <algorithm>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <v8.h>
+#include <nan.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#include "./addon_data.h"
+#include "./buffer_input.h"
+#include "./conversions.h"
+#include "./language.h"
+#include "./tree.h"
+#include "./util.h"
+
+namespace node_tree_sitter {
+
+using namespace v8;
+using std::string;
+using std::vector;
+
+void ParserPool::Init(Local<Object> exports) {
+  Local<FunctionTemplate> tpl = Nan::New<FunctionTemplate>(New);
+  tpl->InstanceTemplate()->SetInternalFieldCount(1);
+  Local<String> class_name = Nan::New("ParserPool").ToLocalChecked();
+  tpl->SetClassName(class_name);
+
+  FunctionPair methods[] = {
+    {"setLanguage", SetLanguage},
+    {"parseMany", ParseMany},
+  };
+
+  GetterPair getters[] = {
+    {"size", Size},
+  };
+
+  for (size_t i = 0; i < length_of_array(methods); i++) {
+    Nan::SetPrototypeMethod(tpl, methods[i].name, methods[i].callback);
+  }
+
+  for (size_t i = 0; i < length_of_array(getters); i++) {
+    Nan::SetAccessor(
+      tpl->InstanceTemplate(),
+      Nan::New(getters[i].name).ToLocalChecked(),
+      getters[i].callback);
+  }
+
+  AddonData *data = AddonData::Get();
+  AddonData::SetOnce(data->parser_pool_constructor, Nan::GetFunction(tpl).ToLocalChecked());
+  Nan::Set(exports, class_name, Nan::New(data->parser_pool_constructor));
+}
+
+ParserPool::ParserPool(size_t size) :
+  is_parsing_async_(false),
+  stopping_(false),
+  results_async_(new uv_async_t),
+  done_callback_(nullptr),
+  progress_callback_(nullptr),
+  async_resource_(nullptr),
+  delivered_count_(0) {
+  uv_async_init(Nan::GetCurrentEventLoop(), results_async_, [](uv_async_t *handle) {
+    static_cast<ParserPool *>(handle->data)->DeliverResults();
+  });
+  results_async_->data = this;
+  uv_unref(reinterpret_cast<uv_handle_t *>(results_async_));
+
+  for (size_t i = 0; i < size; i++) {
+    parsers_.push_back(ts_parser_new());
+  }
+  for (size_t i = 0; i < size; i++) {
+    threads_.emplace_back(&ParserPool::RunThread, this, i);
+  }
+
+  #if NODE_MAJOR_VERSION >= 12
+    node::AddEnvironmentCleanupHook(v8::Isolate::GetCurrent(), StopPool, this);
+  #endif
+}
+
+ParserPool::~ParserPool() {
+  #if NODE_MAJOR_VERSION >= 12
+    node::RemoveEnvironmentCleanupHook(v8::Isolate::GetCurrent(), StopPool, this);
+  #endif
+  Stop();
+  for (TSParser *parser : parsers_) {
+    ts_parser_delete(parser);
+  }
+}
+
+// Lets the threads finish the documents they are parsing, joins them and
+// closes the handle that they wake the main thread with. Runs when the pool
+// is collected, or earlier if its environment is torn down first.
+void ParserPool::Stop() {
+  if (!results_async_) return;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  batch_available_.notify_all();
+  for (std::thread &thread : threads_) {
+    thread.join();
+  }
+  threads_.clear();
+
+  uv_close(reinterpret_cast<uv_handle_t *>(results_async_), [](uv_handle_t *handle) {
+    delete reinterpret_cast<uv_async_t *>(handle);
+  });
+  results_async_ = nullptr;
+
+  // A batch that was still running when its environment went away is
+  // dropped without settling.
+  batch_.reset();
+  delete done_callback_;
+  delete progress_callback_;
+  delete async_resource_;
+  done_callback_ = nullptr;
+  progress_callback_ = nullptr;
+  async_resource_ = nullptr;
+  inputs_.Reset();
+}
+
+void ParserPool::StopPool(void *data) {
+  static_cast<ParserPool *>(data)->Stop();
+}
+
+void ParserPool::New(const Nan::FunctionCallbackInfo<Value> &info) {
+  if (!info.IsConstructCall()) {
+    Nan::ThrowTypeError("ParserPool must be called with `new`");
+    return;
+  }
+
+  size_t size = std::thread::hardware_concurrency();
+  if (info.Length() > 0 && !info[0]->IsUndefined()) {
+    auto maybe_size = Nan::To<uint32_t>(info[0]);
+    if (maybe_size.IsNothing() || maybe_size.FromJust() == 0) {
+      Nan::ThrowTypeError("The pool size must be a positive integer");
+      return;
+    }
+    size = maybe_size.FromJust();
+  }
+  if (size == 0) size = 1;
+
+  ParserPool *pool = new ParserPool(size);
+  pool->Wrap(info.This());
+  info.GetReturnValue().Set(info.This());
+}
+
+void ParserPool::SetLanguage(const Nan::FunctionCallbackInfo<Value> &info) {
+  ParserPool *pool = ObjectWrap::Unwrap<ParserPool>(info.This());
+  if (pool->is_parsing_async_) {
+    Nan::ThrowError("Parser pool is in use");
+    return;
+  }
+
+  const TSLanguage *language = language_methods::UnwrapLanguage(info[0]);
+  if (language) {
+    for (TSParser *parser : pool->parsers_) {
+      ts_parser_set_language(parser, language);
+    }
+    info.GetReturnValue().Set(info.This());
+  }
+}
+
+void ParserPool::Size(Local<String> property, const Nan::PropertyCallbackInfo<Value> &info) {
+  ParserPool *pool = ObjectWrap::Unwrap<ParserPool>(info.This());
+  info.GetReturnValue().Set(Nan::New<Number>(pool->parsers_.size()));
+}
+
+namespace {
+
+struct Document {
+  const char *data;
+  size_t length;
+  string path;
+};
+
+// A finished document, sent from a pool thread back to the main thread.
+// When the document was read from a file, `contents` holds the file's bytes
+// and is handed over to a JS buffer. A document without a tree either could
+// not be read or could not be parsed.
+struct ParsedDocument {
+  uint32_t index;
+  TSTree *tree;
+  char *contents;
+  size_t length;
+  bool read_failed;
+};
+
+// Each pool thread has its own queue of documents. A thread takes work from
+// the front of its own queue and, once that is empty, steals from the back of
+// the other threads' queues.
+struct WorkQueue {
+  std::mutex mutex;
+  std::deque<uint32_t> indices;
+};
+
+// The size of a file, or zero if it can't be found. It is only used to
+// order the documents, so it doesn't need to open the file.
+size_t FileSize(const string &path) {
+#ifdef _WIN32
+  int wide_length = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, nullptr, 0);
+  vector<wchar_t> wide_path(wide_length);
+  MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, wide_path.data(), wide_length);
+  WIN32_FILE_ATTRIBUTE_DATA attributes;
+  if (!GetFileAttributesExW(wide_path.data(), GetFileExInfoStandard, &attributes)) return 0;
+  return (static_cast<size_t>(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow;
+#else
+  struct stat info;
+  if (stat(path.c_str(), &info) != 0) return 0;
+  return static_cast<size_t>(info.st_size);
+#endif
+}
+
+}  // namespace
+
+// The documents of one call to `parseMany`. It holds no JS handles, so the
+// last thread to let go of it can delete it.
+struct ParseBatch {
+  ParseBatch(vector<Document> &&documents, TSInputEncoding encoding, size_t queue_count) :
+    documents(std::move(documents)),
+    encoding(encoding),
+    queues(queue_count) {}
+
+  ~ParseBatch() {
+    for (const ParsedDocument &result : results) {
+      if (result.tree) ts_tree_delete(result.tree);
+      free(result.contents);
+    }
+  }
+
+  // Deals the documents out largest first, so that the big ones start early
+  // and the small ones fill in the gaps at the end. Files are sized without
+  // being opened; each is opened once, by the thread that parses it.
+  void Deal() {
+    vector<size_t> sizes(documents.size());
+    vector<uint32_t> order(documents.size());
+    for (uint32_t i = 0; i < documents.size(); i++) {
+      order[i] = i;
+      sizes[i] = documents[i].data ? documents[i].length : FileSize(documents[i].path);
+    }
+
+    std::stable_sort(order.begin(), order.end(), [&sizes](uint32_t a, uint32_t b) {
+      return sizes[a] > sizes[b];
+    });
+
+    for (size_t i = 0; i < order.size(); i++) {
+      queues[i % queues.size()].indices.push_back(order[i]);
+    }
+  }
+
+  bool Next(size_t thread_index, uint32_t *index) {
+    for (size_t i = 0; i < queues.size(); i++) {
+      WorkQueue &queue = queues[(thread_index + i) % queues.size()];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      if (queue.indices.empty()) continue;
+      if (i == 0) {
+        *index = queue.indices.front();
+        queue.indices.pop_front();
+      } else {
+        *index = queue.indices.back();
+        queue.indices.pop_back();
+      }
+      return true;
+    }
+    return false;
+  }
+
+  ParsedDocument Parse(TSParser *parser, uint32_t index) const {
+    ParsedDocument result = {index, nullptr, nullptr, 0, false};
+    const Document &document = documents[index];
+    const char *data = document.data;
+    size_t length = document.length;
+
+    if (!data) {
+      // Directories and other unseekable paths report a negative size.
+      result.read_failed = true;
+      std::ifstream file(document.path, std::ios::binary | std::ios::ate);
+      if (!file) return result;
+      std::streamoff size = file.tellg();
+      if (size < 0) return result;
+      length = static_cast<size_t>(size);
+      result.contents = static_cast<char *>(malloc(length ? length : 1));
+      if (!result.contents) return result;
+      result.length = length;
+      file.seekg(0);
+      if (!file.read(result.contents, length)) return result;
+      result.read_failed = false;
+      data = result.contents;
+    }
+
+    BufferInput input(data, length, encoding);
+    result.tree = ts_parser_parse(parser, nullptr, input.input());
+    return result;
+  }
+
+  vector<Document> documents;
+  TSInputEncoding encoding;
+  vector<WorkQueue> queues;
+  std::once_flag dealt;
+
+  std::mutex results_mutex;
+  vector<ParsedDocument> results;
+};
+
+void ParserPool::RunThread(size_t thread_index) {
+  TSParser *parser = parsers_[thread_index];
+  std::shared_ptr<ParseBatch> finished;
+  for (;;) {
+    std::shared_ptr<ParseBatch> batch;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      batch_available_.wait(lock, [&]() {
+        return stopping_ || (batch_ && batch_ != finished);
+      });
+      if (stopping_) return;
+      batch = batch_;
+    }
+
+    // The first thread to see the batch orders it, while the others wait.
+    std::call_once(batch->dealt, [&batch]() { batch->Deal(); });
+
+    uint32_t index;
+    while (batch->Next(thread_index, &index)) {
+      ParsedDocument result = batch->Parse(parser, index);
+      {
+        std::lock_guard<std::mutex> lock(batch->results_mutex);
+        batch->results.push_back(result);
+      }
+      uv_async_send(results_async_);
+
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (stopping_) return;
+    }
+    finished = std::move(batch);
+  }
+}
+
+// Runs on the main thread, and hands the documents parsed so far to JS.
+void ParserPool::DeliverResults() {
+  std::shared_ptr<ParseBatch> batch;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    batch = batch_;
+  }
+  if (!batch) return;
+
+  vector<ParsedDocument> results;
+  {
+    std::lock_guard<std::mutex> lock(batch->results_mutex);
+    results.swap(batch->results);
+  }
+
+  Nan::HandleScope scope;
+  for (const ParsedDocument &result : results) {
+    const Document &document = batch->documents[result.index];
+    Local<Value> argv[4] = {
+      Nan::Null(),
+      Nan::New<Number>(result.index),
+      Nan::Null(),
+      Nan::Undefined(),
+    };
+
+    if (result.tree) {
+      argv[2] = Tree::NewInstance(result.tree, batch->encoding);
+      if (result.contents) {
+        argv[3] = Nan::NewBuffer(result.contents, result.length).ToLocalChecked();
+      }
+    } else {
+      free(result.contents);
+      string message;
+      if (result.read_failed) {
+        message = "Could not read file " + document.path;
+      } else if (document.data) {
+        message = "Could not parse input " + std::to_string(result.index);
+      } else {
+        message = "Could not parse file " + document.path;
+      }
+      argv[0] = Nan::Error(message.c_str());
+    }
+
+    delivered_count_++;
+    progress_callback_->Call(4, argv, async_resource_);
+  }
+
+  if (delivered_count_ < batch->documents.size()) return;
+
+  // The pool is ready for another batch before the promise settles.
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    batch_.reset();
+  }
+  Nan::Callback *done_callback = done_callback_;
+  Nan::AsyncResource *async_resource = async_resource_;
+  delete progress_callback_;
+  done_callback_ = nullptr;
+  progress_callback_ = nullptr;
+  async_resource_ = nullptr;
+  inputs_.Reset();
+  is_parsing_async_ = false;
+  uv_unref(reinterpret_cast<uv_handle_t *>(results_async_));
+
+  done_callback->Call(0, nullptr, async_resource);
+  delete done_callback;
+  delete async_resource;
+  Unref();
+}
+
+void ParserPool::ParseMany(const Nan::FunctionCallbackInfo<Value> &info) {
+  ParserPool *pool = ObjectWrap::Unwrap<ParserPool>(info.This());
+  if (pool->is_parsing_async_) {
+    Nan::ThrowError("Parser pool is in use");
+    return;
+  }
+
+  if (!pool->results_async_) {
+    Nan::ThrowError("The parser pool has been stopped");
+    return;
+  }
+
+  if (!ts_parser_language(pool->parsers_[0])) {
+    Nan::ThrowError("The parser pool has no language");
+    return;
+  }
+
+  if (!info[2]->IsArray()) {
+    Nan::ThrowTypeError("Inputs must be an array of buffers or file paths");
+    return;
+  }
+
+  // Like `Parser`, the pool reads UTF-16 unless it is told otherwise.
+  TSInputEncoding encoding = TSInputEncodingUTF16;
+  if (!info[3]->IsUndefined()) {
+    auto maybe_encoding = EncodingFromJS(info[3]);
+    if (maybe_encoding.IsNothing()) return;
+    encoding = maybe_encoding.FromJust();
+  }
+
+  auto js_inputs = Local<Array>::Cast(info[2]);
+  vector<Document> documents;
+  for (uint32_t i = 0, n = js_inputs->Length(); i < n; i++) {
+    Local<Value> js_input;
+    if (!Nan::Get(js_inputs, i).ToLocal(&js_input)) return;
+
+    Document document = {nullptr, 0, string()};
+    if (js_input->IsString()) {
+      document.path = *Nan::Utf8String(js_input);
+    } else if (!buffer_contents(js_input, &document.data, &document.length)) {
+      Nan::ThrowTypeError("Inputs must be an array of buffers or file paths");
+      return;
+    }
+    documents.push_back(std::move(document));
+  }
+
+  if (documents.empty()) {
+    Nan::Callback callback(info[0].As<Function>());
+    Nan::Call(callback, 0, nullptr);
+    return;
+  }
+
+  // Buffers are read in place, so they are kept alive, along with the pool,
+  // until every document has been parsed.
+  pool->done_callback_ = new Nan::Callback(info[0].As<Function>());
+  pool->progress_callback_ = new Nan::Callback(info[1].As<Function>());
+  pool->async_resource_ = new Nan::AsyncResource("tree-sitter.parseMany");
+  pool->inputs_.Reset(js_inputs);
+  pool->delivered_count_ = 0;
+  pool->is_parsing_async_ = true;
+  pool->Ref();
+  uv_ref(reinterpret_cast<uv_handle_t *>(pool->results_async_));
+
+  {
+    std::lock_guard<std::mutex> lock(pool->mutex_);
+    pool->batch_ = std::make_shared<ParseBatch>(
+      std::move(documents), encoding, pool->threads_.size());
+  }
+  pool->batch_available_.notify_all();
+}
+
+}  // namespace node_tree_sitter
@@ -0,0 +1,64 @@
+#ifndef NODE_TREE_SITTER_PARSER_POOL_H_
+#define NODE_TREE_SITTER_PARSER_POOL_H_
+
+#include <v8.h>
+#include <nan.h>
+#include <node_object_wrap.h>
+#include <uv.h>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <tree_sitter/api.h>
+
+namespace node_tree_sitter {
+
+struct ParseBatch;
+
+// A set of parsers for one language, each with a thread of its own. The
+// threads live as long as the pool and wait for batches from `parseMany`,
+// so a batch neither starts threads nor holds one of libuv's threads.
+class ParserPool : public Nan::ObjectWrap {
+ public:
+  static void Init(v8::Local<v8::Object> exports);
+
+ private:
+  explicit ParserPool(size_t size);
+  ~ParserPool();
+
+  static void New(const Nan::FunctionCallbackInfo<v8::Value> &);
+  static void SetLanguage(const Nan::FunctionCallbackInfo<v8::Value> &);
+  static void ParseMany(const Nan::FunctionCallbackInfo<v8::Value> &);
+  static void Size(v8::Local<v8::String>, const Nan::PropertyCallbackInfo<v8::Value> &);
+
+  void RunThread(size_t thread_index);
+  void DeliverResults();
+  void Stop();
+  static void StopPool(void *);
+
+  std::vector<TSParser *> parsers_;
+  std::vector<std::thread> threads_;
+  bool is_parsing_async_;
+
+  // Guards `batch_` and `stopping_`, and wakes the threads when either
+  // changes.
+  std::mutex mutex_;
+  std::condition_variable batch_available_;
+  std::shared_ptr<ParseBatch> batch_;
+  bool stopping_;
+
+  // Wakes the main thread when documents have been parsed.
+  uv_async_t *results_async_;
+
+  // The JS side of the current batch, only touched on the main thread.
+  Nan::Callback *done_callback_;
+  Nan::Callback *progress_callback_;
+  Nan::AsyncResource *async_resource_;
+  Nan::Persistent<v8::Object> inputs_;
+  size_t delivered_count_;
+};
+
+}  // namespace node_tree_sitter
+
+#endif  // NODE_TREE_SITTER_PARSER_POOL_H_
@@ -1,19 +1,39 @@
 #include "./query.h"
+#include <algorithm>
+#include <cstring>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <v8.h>
 #include <nan.h>
+#include "./addon_data.h"
+#include "./buffer_input.h"
 #include "./node.h"
 #include "./language.h"
 #include "./logger.h"
+#include "./query_match_iterator.h"
 #include "./util.h"
 #include "./conversions.h"
 
 namespace node_tree_sitter {
 
+using std::string;
+using std::string_view;
 using std::vector;
 using namespace v8;
-using node_methods::UnmarshalNodeId;
+
+// `RegExp::Exec` lets `#match?` predicates run without calling into JS.
+#if V8_MAJOR_VERSION >= 9
+#define NODE_TREE_SITTER_NATIVE_REGEX 1
+#endif
+
+static const size_t MAX_POOLED_CURSORS = 8;
+
+// Each capture returned by `capturesCompact` is eight values: the pattern
+// index, the capture id, the start and end index, and the start and end
+// row and column.
+static const uint32_t CAPTURE_SIZE = 8;
 
 const char *query_error_names[] = {
   "TSQueryErrorNone",
@@ -24,12 +44,95 @@ const char *query_error_names[] = {
   "TSQueryErrorStructure",
 };
 
-TSQueryCursor *Query::ts_query_cursor;
-Nan::Persistent<Function> Query::constructor;
-Nan::Persistent<FunctionTemplate> Query::constructor_template;
+namespace {
+
+// Encodes a UTF8 string as UTF16LE, to compare it with the source of a tree
+// that was parsed as UTF16.
+string UTF8ToUTF16(string_view utf8) {
+  string result;
+  size_t i = 0;
+  while (i < utf8.size()) {
+    uint8_t byte = utf8[i];
+    uint32_t code_point = 0xFFFD;
+    size_t size = 1;
+    size_t extra =
+      (byte & 0xE0) == 0xC0 ? 1 :
+      (byte & 0xF0) == 0xE0 ? 2 :
+      (byte & 0xF8) == 0xF0 ? 3 : 0;
+    if (byte < 0x80) {
+      code_point = byte;
+    } else if (extra && i + extra < utf8.size()) {
+      uint32_t value = byte & (0x3F >> extra);
+      size_t j = 1;
+      for (; j <= extra && (static_cast<uint8_t>(utf8[i + j]) & 0xC0) == 0x80; j++) {
+        value = (value << 6) | (utf8[i + j] & 0x3F);
+      }
+      if (j > extra) {
+        code_point = value;
+        size = j;
+      }
+    }
+
+    uint16_t units[2] = {static_cast<uint16_t>(code_point), 0};
+    size_t unit_count = 1;
+    if (code_point >= 0x10000) {
+      units[0] = 0xD800 + ((code_point - 0x10000) >> 10);
+      units[1] = 0xDC00 + ((code_point - 0x10000) & 0x3FF);
+      unit_count = 2;
+    }
+    for (size_t k = 0; k < unit_count; k++) {
+      result.push_back(static_cast<char>(units[k] & 0xFF));
+      result.push_back(static_cast<char>(units[k] >> 8));
+    }
+    i += size;
+  }
+  return result;
+}
+
+string_view NodeSource(TSNode node, const char *source, size_t length) {
+  size_t start = std::min<size_t>(ts_node_start_byte(node), length);
+  size_t end = std::min<size_t>(ts_node_end_byte(node), length);
+  return string_view(source + start, end > start ? end - start : 0);
+}
+
+Local<String> SourceToJS(string_view text, TSInputEncoding encoding) {
+  if (encoding == TSInputEncodingUTF8) {
+    return Nan::New<String>(text.data(), text.size()).ToLocalChecked();
+  }
+  // The source may not be aligned for UTF16 reads, so it is copied first.
+  vector<uint16_t> units(text.size() / 2);
+  memcpy(units.data(), text.data(), units.size() * 2);
+  return Nan::New<String>(units.data(), units.size()).ToLocalChecked();
+}
+
+// Appends a capture in the form returned by `capturesCompact`.
+void AppendCaptureValues(vector<uint32_t> *values, uint32_t pattern_index,
+                         const TSQueryCapture &capture, uint32_t bytes_per_character) {
+  TSPoint start_position = ts_node_start_point(capture.node);
+  TSPoint end_position = ts_node_end_point(capture.node);
+  values->push_back(pattern_index);
+  values->push_back(capture.index);
+  values->push_back(ts_node_start_byte(capture.node) / bytes_per_character);
+  values->push_back(ts_node_end_byte(capture.node) / bytes_per_character);
+  values->push_back(start_position.row);
+  values->push_back(start_position.column / bytes_per_character);
+  values->push_back(end_position.row);
+  values->push_back(end_position.column / bytes_per_character);
+}
+
+Local<Uint32Array> Uint32ArrayFrom(const vector<uint32_t> &values) {
+  Local<Object> buffer = Nan::CopyBuffer(
+    reinterpret_cast<const char *>(values.data()),
+    values.size() * sizeof(uint32_t)
+  ).ToLocalChecked();
+  Local<Uint8Array> bytes = buffer.As<Uint8Array>();
+  return Uint32Array::New(bytes->Buffer(), bytes->ByteOffset(), values.size());
+}
+
+}  // namespace
 
 void Query::Init(Local<Object> exports) {
-  ts_query_cursor = ts_query_cursor_new();
+  AddonData *data = AddonData::Get();
 
   Local<FunctionTemplate> tpl = Nan::New<FunctionTemplate>(New);
   tpl->InstanceTemplate()->SetInternalFieldCount(1);
@@ -39,7 +142,12 @@ void Query::Init(Local<Object> exports) {
   FunctionPair methods[] = {
     {"_matches", Matches},
     {"_captures", Captures},
+    {"_capturesCompact", CapturesCompact},
+    {"_iterMatches", IterMatches},
+    {"_matchesAsync", MatchesAsync},
     {"_getPredicates", GetPredicates},
+    {"_getCaptureNames", GetCaptureNames},
+    {"didExceedMatchLimit", DidExceedMatchLimit},
   };
 
   for (size_t i = 0; i < length_of_array(methods); i++) {
@@ -47,13 +155,14 @@ void Query::Init(Local<Object> exports) {
   }
 
   Local<Function> ctor = Nan::GetFunction(tpl).ToLocalChecked();
+  Nan::Set(ctor, Nan::New("CAPTURE_SIZE").ToLocalChecked(), Nan::New(CAPTURE_SIZE));
 
-  constructor_template.Reset(tpl);
-  constructor.Reset(ctor);
-  Nan::Set(exports, class_name, ctor);
+  AddonData::SetOnce(data->query_constructor_template, tpl);
+  AddonData::SetOnce(data->query_constructor, ctor);
+  Nan::Set(exports, class_name, Nan::New(data->query_constructor));
 }
 
-Query::Query(TSQuery *query) : query_(query) {}
+Query::Query(TSQuery *query) : query_(query), did_exceed_match_limit_(false) {}
 
 Query::~Query() {
   ts_query_delete(query_);
@@ -62,7 +171,7 @@ Query::~Query() {
 Local<Value> Query::NewInstance(TSQuery *query) {
   if (query) {
     Local<Object> self;
-    MaybeLocal<Object> maybe_self = Nan::NewInstance(Nan::New(constructor));
+    MaybeLocal<Object> maybe_self = Nan::NewInstance(Nan::New(AddonData::Get()->query_constructor));
     if (maybe_self.ToLocal(&self)) {
       (new Query(query))->Wrap(self);
       return self;
@@ -74,14 +183,14 @@ Local<Value> Query::NewInstance(TSQuery *query) {
 Query *Query::UnwrapQuery(const Local<Value> &value) {
   if (!value->IsObject()) return nullptr;
   Local<Object> js_query = Local<Object>::Cast(value);
-  if (!Nan::New(constructor_template)->HasInstance(js_query)) return nullptr;
+  if (!Nan::New(AddonData::Get()->query_constructor_template)->HasInstance(js_query)) return nullptr;
   return ObjectWrap::Unwrap<Query>(js_query);
 }
 
 void Query::New(const Nan::FunctionCallbackInfo<Value> &info) {
   if (!info.IsConstructCall()) {
     Local<Object> self;
-    MaybeLocal<Object> maybe_self = Nan::New(constructor)->NewInstance(Nan::GetCurrentContext());
+    MaybeLocal<Object> maybe_self = Nan::New(AddonData::Get()->query_constructor)->NewInstance(Nan::GetCurrentContext());
     if (maybe_self.ToLocal(&self)) {
       info.GetReturnValue().Set(self);
     } else {
@@ -138,11 +247,197 @@ void Query::New(const Nan::FunctionCallbackInfo<Value> &info) {
     Nan::To<Function>(
       Nan::Get(self, Nan::New<String>("_init").ToLocalChecked()).ToLocalChecked()
     ).ToLocalChecked();
-  Nan::Call(init, self, 0, nullptr);
+  Local<Value> argv[1] = {query_wrapper->CompileTextPredicates()};
+  Nan::Call(init, self, 1, argv);
 
   info.GetReturnValue().Set(self);
 }
 
+// Query cursors are pooled per isolate. Each execution takes a cursor of its
+// own, so that executions can be nested or interleaved, and returns it when
+// it is done.
+TSQueryCursor *Query::AcquireCursor(uint32_t match_limit) {
+  AddonData *data = AddonData::Get();
+  TSQueryCursor *cursor;
+  if (data && !data->query_cursors.empty()) {
+    cursor = data->query_cursors.back();
+    data->query_cursors.pop_back();
+  } else {
+    cursor = ts_query_cursor_new();
+  }
+  ts_query_cursor_set_match_limit(cursor, match_limit);
+  return cursor;
+}
+
+void Query::ReleaseCursor(TSQueryCursor *cursor) {
+  AddonData *data = AddonData::Get();
+  if (data && data->query_cursors.size() < MAX_POOLED_CURSORS) {
+    data->query_cursors.push_back(cursor);
+  } else {
+    ts_query_cursor_delete(cursor);
+  }
+}
+
+// Reads the `matchLimit` option, which caps the number of matches that a
+// cursor keeps in progress at once.
+bool Query::MatchLimitFromJS(Local<Value> value, uint32_t *match_limit) {
+  *match_limit = UINT32_MAX;
+  if (value->IsUndefined()) return true;
+  *match_limit = Nan::To<uint32_t>(value).FromMaybe(0);
+  if (*match_limit == 0) {
+    Nan::ThrowTypeError("Match limit must be a positive integer");
+    return false;
+  }
+  return true;
+}
+
+// Finds the text that a query's text predicates are checked against: either
+// a buffer passed from JS, or the file that the tree was parsed from.
+bool Query::SourceText(const Tree *tree, Local<Value> value, const char **data, size_t *length) {
+  if (buffer_contents(value, data, length)) return true;
+  if (tree->source_) {
+    *data = tree->source_->data();
+    *length = tree->source_->length();
+    return true;
+  }
+  return false;
+}
+
+// Compiles the `#eq?`, `#not-eq?` and `#match?` predicates that can be
+// checked natively. Returns an array with one array of booleans for each
+// pattern, saying which of its predicates were compiled. The others, along
+// with any malformed predicates, are left to JS.
+Local<Array> Query::CompileTextPredicates() {
+  uint32_t pattern_count = ts_query_pattern_count(query_);
+  Local<Array> js_compiled = Nan::New<Array>(pattern_count);
+  text_predicates_.resize(pattern_count);
+
+  for (uint32_t pattern_index = 0; pattern_index < pattern_count; pattern_index++) {
+    uint32_t step_count;
+    const TSQueryPredicateStep *steps = ts_query_predicates_for_pattern(
+      query_, pattern_index, &step_count);
+
+    Local<Array> js_pattern_compiled = Nan::New<Array>();
+    uint32_t predicate_index = 0;
+    uint32_t start = 0;
+    while (start < step_count) {
+      uint32_t end = start;
+      while (end < step_count && steps[end].type != TSQueryPredicateStepTypeDone) end++;
+      const TSQueryPredicateStep *predicate = steps + start;
+      bool is_compiled = false;
+
+      if (end - start == 3 &&
+          predicate[0].type == TSQueryPredicateStepTypeString &&
+          predicate[1].type == TSQueryPredicateStepTypeCapture) {
+        uint32_t length;
+        const char *value = ts_query_string_value_for_id(query_, predicate[0].value_id, &length);
+        string_view op(value, length);
+
+        TextPredicate text_predicate;
+        text_predicate.is_positive = op != "not-eq?";
+        text_predicate.capture_id = predicate[1].value_id;
+        text_predicate.other_capture_id = 0;
+
+        if (op == "eq?" || op == "not-eq?") {
+          if (predicate[2].type == TSQueryPredicateStepTypeCapture) {
+            text_predicate.kind = TextPredicate::EqCapture;
+            text_predicate.other_capture_id = predicate[2].value_id;
+          } else {
+            value = ts_query_string_value_for_id(query_, predicate[2].value_id, &length);
+            text_predicate.kind = TextPredicate::EqString;
+            text_predicate.utf8_value.assign(value, length);
+            text_predicate.utf16_value = UTF8ToUTF16(string_view(value, length));
+          }
+          is_compiled = true;
+        }
+#ifdef NODE_TREE_SITTER_NATIVE_REGEX
+        else if (op == "match?" && predicate[2].type == TSQueryPredicateStepTypeString) {
+          // Invalid patterns are reported by JS, which compiles them too.
+          Nan::TryCatch try_catch;
+          value = ts_query_string_value_for_id(query_, predicate[2].value_id, &length);
+          Local<RegExp> regex;
+          if (RegExp::New(
+            Nan::GetCurrentContext(),
+            Nan::New<String>(value, length).ToLocalChecked(),
+            RegExp::kNone
+          ).ToLocal(&regex)) {
+            text_predicate.kind = TextPredicate::Match;
+            text_predicate.regex.Reset(regex);
+            is_compiled = true;
+          }
+        }
+#endif
+
+        if (is_compiled) {
+          text_predicates_[pattern_index].push_back(std::move(text_predicate));
+        }
+      }
+
+      Nan::Set(js_pattern_compiled, predicate_index++, Nan::New(is_compiled));
+      start = end + 1;
+    }
+
+    Nan::Set(js_compiled, pattern_index, js_pattern_compiled);
+  }
+
+  return js_compiled;
+}
+
+// Checks a match against its pattern's text predicates. When a predicate's
+// capture appears more than once, `#eq?` with a string and `#match?` look at
+// the first node, while `#eq?` with two captures looks at the last ones.
+bool Query::SatisfiesTextPredicates(const TSQueryMatch &match, const char *source,
+                                    size_t length, TSInputEncoding encoding,
+                                    TextPredicateSet predicate_set) const {
+  for (const TextPredicate &predicate : text_predicates_[match.pattern_index]) {
+    bool is_regex = predicate.kind == TextPredicate::Match;
+    if (predicate_set == EqualityPredicates && is_regex) continue;
+    if (predicate_set == RegexPredicates && !is_regex) continue;
+
+    const TSNode *node = nullptr;
+    const TSNode *other_node = nullptr;
+    for (uint16_t i = 0; i < match.capture_count; i++) {
+      const TSQueryCapture &capture = match.captures[i];
+      if (capture.index == predicate.capture_id &&
+          (!node || predicate.kind == TextPredicate::EqCapture)) {
+        node = &capture.node;
+      }
+      if (predicate.kind == TextPredicate::EqCapture &&
+          capture.index == predicate.other_capture_id) {
+        other_node = &capture.node;
+      }
+    }
+    if (!node) continue;
+
+    string_view text = NodeSource(*node, source, length);
+    switch (predicate.kind) {
+      case TextPredicate::EqString: {
+        const string &value = encoding == TSInputEncodingUTF8
+          ? predicate.utf8_value
+          : predicate.utf16_value;
+        if ((text == value) != predicate.is_positive) return false;
+        break;
+      }
+      case TextPredicate::EqCapture:
+        if (!other_node) continue;
+        if ((text == NodeSource(*other_node, source, length)) != predicate.is_positive) return false;
+        break;
+      case TextPredicate::Match: {
+#ifdef NODE_TREE_SITTER_NATIVE_REGEX
+        Local<Object> result;
+        if (!Nan::New(predicate.regex)->Exec(
+          Nan::GetCurrentContext(),
+          SourceToJS(text, encoding)
+        ).ToLocal(&result)) return false;
+        if (result->IsNull() == predicate.is_positive) return false;
+#endif
+        break;
+      }
+    }
+  }
+  return true;
+}
+
 void Query::GetPredicates(const Nan::FunctionCallbackInfo<Value> &info) {
   Query *query = Query::UnwrapQuery(info.This());
   auto ts_query = query->query_;
@@ -198,11 +493,11 @@ void Query::GetPredicates(const Nan::FunctionCallbackInfo<Value> &info) {
 
 void Query::Matches(const Nan::FunctionCallbackInfo<Value> &info) {
   Query *query = Query::UnwrapQuery(info.This());
-  const Tree *tree = Tree::UnwrapTree(info[0]);
+  Tree *tree = Tree::UnwrapTree(info[0]);
   uint32_t start_row    = Nan::To<uint32_t>(info[1]).ToChecked();
-  uint32_t start_column = Nan::To<uint32_t>(info[2]).ToChecked() << 1;
+  uint32_t start_column = Nan::To<uint32_t>(info[2]).ToChecked();
   uint32_t end_row      = Nan::To<uint32_t>(info[3]).ToChecked();
-  uint32_t end_column   = Nan::To<uint32_t>(info[4]).ToChecked() << 1;
+  uint32_t end_column   = Nan::To<uint32_t>(info[4]).ToChecked();
 
   if (query == nullptr) {
     Nan::ThrowError("Missing argument query");
@@ -214,10 +509,21 @@ void Query::Matches(const Nan::FunctionCallbackInfo<Value> &info) {
     return;
   }
 
+  start_column *= BytesPerCharacter(tree->encoding_);
+  end_column *= BytesPerCharacter(tree->encoding_);
+
+  const char *source;
+  size_t source_length;
+  bool has_source = Query::SourceText(tree, info[5], &source, &source_length);
+
+  uint32_t match_limit;
+  if (!Query::MatchLimitFromJS(info[6], &match_limit)) return;
+
   TSQuery *ts_query = query->query_;
   TSNode rootNode = node_methods::UnmarshalNode(tree);
   TSPoint start_point = {start_row, start_column};
   TSPoint end_point = {end_row, end_column};
+  TSQueryCursor *ts_query_cursor = Query::AcquireCursor(match_limit);
   ts_query_cursor_set_point_range(ts_query_cursor, start_point, end_point);
   ts_query_cursor_exec(ts_query_cursor, ts_query, rootNode);
 
@@ -227,6 +533,10 @@ void Query::Matches(const Nan::FunctionCallbackInfo<Value> &info) {
   TSQueryMatch match;
 
   while (ts_query_cursor_next_match(ts_query_cursor, &match)) {
+    if (has_source && !query->SatisfiesTextPredicates(match, source, source_length, tree->encoding_)) {
+      continue;
+    }
+
     Nan::Set(js_matches, index++, Nan::New(match.pattern_index));
 
     for (uint16_t i = 0; i < match.capture_count; i++) {
@@ -244,21 +554,25 @@ void Query::Matches(const Nan::FunctionCallbackInfo<Value> &info) {
     }
   }
 
+  query->did_exceed_match_limit_ = ts_query_cursor_did_exceed_match_limit(ts_query_cursor);
+  Query::ReleaseCursor(ts_query_cursor);
+
   auto js_nodes = node_methods::GetMarshalNodes(info, tree, nodes.data(), nodes.size());
 
   auto result = Nan::New<Array>();
   Nan::Set(result, 0, js_matches);
   Nan::Set(result, 1, js_nodes);
+  Nan::Set(result, 2, Nan::New(has_source));
   info.GetReturnValue().Set(result);
 }
 
 void Query::Captures(const Nan::FunctionCallbackInfo<Value> &info) {
   Query *query = Query::UnwrapQuery(info.This());
-  const Tree *tree = Tree::UnwrapTree(info[0]);
+  Tree *tree = Tree::UnwrapTree(info[0]);
   uint32_t start_row    = Nan::To<uint32_t>(info[1]).ToChecked();
-  uint32_t start_column = Nan::To<uint32_t>(info[2]).ToChecked() << 1;
+  uint32_t start_column = Nan::To<uint32_t>(info[2]).ToChecked();
   uint32_t end_row      = Nan::To<uint32_t>(info[3]).ToChecked();
-  uint32_t end_column   = Nan::To<uint32_t>(info[4]).ToChecked() << 1;
+  uint32_t end_column   = Nan::To<uint32_t>(info[4]).ToChecked();
 
   if (query == nullptr) {
     Nan::ThrowError("Missing argument query");
@@ -270,10 +584,21 @@ void Query::Captures(const Nan::FunctionCallbackInfo<Value> &info) {
     return;
   }
 
+  start_column *= BytesPerCharacter(tree->encoding_);
+  end_column *= BytesPerCharacter(tree->encoding_);
+
+  const char *source;
+  size_t source_length;
+  bool has_source = Query::SourceText(tree, info[5], &source, &source_length);
+
+  uint32_t match_limit;
+  if (!Query::MatchLimitFromJS(info[6], &match_limit)) return;
+
   TSQuery *ts_query = query->query_;
   TSNode rootNode = node_methods::UnmarshalNode(tree);
   TSPoint start_point = {start_row, start_column};
   TSPoint end_point = {end_row, end_column};
+  TSQueryCursor *ts_query_cursor = Query::AcquireCursor(match_limit);
   ts_query_cursor_set_point_range(ts_query_cursor, start_point, end_point);
   ts_query_cursor_exec(ts_query_cursor, ts_query, rootNode);
 
@@ -288,6 +613,10 @@ void Query::Captures(const Nan::FunctionCallbackInfo<Value> &info) {
     &match,
     &capture_index
   )) {
+    if (has_source && !query->SatisfiesTextPredicates(match, source, source_length, tree->encoding_)) {
+      ts_query_cursor_remove_match(ts_query_cursor, match.id);
+      continue;
+    }
 
     Nan::Set(js_matches, index++, Nan::New(match.pattern_index));
     Nan::Set(js_matches, index++, Nan::New(capture_index));
@@ -307,13 +636,308 @@ void Query::Captures(const Nan::FunctionCallbackInfo<Value> &info) {
     }
   }
 
+  query->did_exceed_match_limit_ = ts_query_cursor_did_exceed_match_limit(ts_query_cursor);
+  Query::ReleaseCursor(ts_query_cursor);
+
   auto js_nodes = node_methods::GetMarshalNodes(info, tree, nodes.data(), nodes.size());
 
   auto result = Nan::New<Array>();
   Nan::Set(result, 0, js_matches);
   Nan::Set(result, 1, js_nodes);
+  Nan::Set(result, 2, Nan::New(has_source));
   info.GetReturnValue().Set(result);
 }
 
+void Query::GetCaptureNames(const Nan::FunctionCallbackInfo<Value> &info) {
+  Query *query = Query::UnwrapQuery(info.This());
+  uint32_t capture_count = ts_query_capture_count(query->query_);
+  Local<Array> js_names = Nan::New<Array>(capture_count);
+  for (uint32_t i = 0; i < capture_count; i++) {
+    uint32_t length;
+    const char *name = ts_query_capture_name_for_id(query->query_, i, &length);
+    Nan::Set(js_names, i, Nan::New<String>(name, length).ToLocalChecked());
+  }
+  info.GetReturnValue().Set(js_names);
+}
+
+// Like `Captures`, but writes each capture's ids and range into a flat
+// array instead of creating nodes and capture names. Returns null when the
+// query's text predicates can't be checked natively, so that JS can check
+// them against nodes instead.
+void Query::CapturesCompact(const Nan::FunctionCallbackInfo<Value> &info) {
+  Query *query = Query::UnwrapQuery(info.This());
+  Tree *tree = Tree::UnwrapTree(info[0]);
+  uint32_t start_row    = Nan::To<uint32_t>(info[1]).ToChecked();
+  uint32_t start_column = Nan::To<uint32_t>(info[2]).ToChecked();
+  uint32_t end_row      = Nan::To<uint32_t>(info[3]).ToChecked();
+  uint32_t end_column   = Nan::To<uint32_t>(info[4]).ToChecked();
+
+  if (query == nullptr) {
+    Nan::ThrowError("Missing argument query");
+    return;
+  }
+
+  if (tree == nullptr) {
+    Nan::ThrowError("Missing argument tree");
+    return;
+  }
+
+  uint32_t bytes_per_character = BytesPerCharacter(tree->encoding_);
+  start_column *= bytes_per_character;
+  end_column *= bytes_per_character;
+
+  const char *source;
+  size_t source_length;
+  bool has_source = Query::SourceText(tree, info[5], &source, &source_length);
+  if (!has_source && Nan::To<bool>(info[7]).FromMaybe(false)) {
+    info.GetReturnValue().Set(Nan::Null());
+    return;
+  }
+
+  uint32_t match_limit;
+  if (!Query::MatchLimitFromJS(info[6], &match_limit)) return;
+
+  TSQuery *ts_query = query->query_;
+  TSNode rootNode = node_methods::UnmarshalNode(tree);
+  TSPoint start_point = {start_row, start_column};
+  TSPoint end_point = {end_row, end_column};
+  TSQueryCursor *ts_query_cursor = Query::AcquireCursor(match_limit);
+  ts_query_cursor_set_point_range(ts_query_cursor, start_point, end_point);
+  ts_query_cursor_exec(ts_query_cursor, ts_query, rootNode);
+
+  vector<uint32_t> values;
+  TSQueryMatch match;
+  uint32_t capture_index;
+
+  while (ts_query_cursor_next_capture(ts_query_cursor, &match, &capture_index)) {
+    if (has_source && !query->SatisfiesTextPredicates(match, source, source_length, tree->encoding_)) {
+      ts_query_cursor_remove_match(ts_query_cursor, match.id);
+      continue;
+    }
+
+    AppendCaptureValues(&values, match.pattern_index, match.captures[capture_index], bytes_per_character);
+  }
+
+  query->did_exceed_match_limit_ = ts_query_cursor_did_exceed_match_limit(ts_query_cursor);
+  Query::ReleaseCursor(ts_query_cursor);
+
+  info.GetReturnValue().Set(Uint32ArrayFrom(values));
+}
+
+namespace {
+
+// Runs a query on the thread pool, against a copy of the tree, so that the
+// original tree can be used and even edited in the meantime. The equality
+// predicates are checked on the worker, and the `#match?` predicates once
+// the results are back on the main thread.
+class MatchesWorker : public Nan::AsyncWorker {
+ public:
+  MatchesWorker(Nan::Callback *callback, Query *query, Tree *tree, TSNode node,
+                TSPoint start_point, TSPoint end_point, uint32_t match_limit,
+                bool has_source, const char *source, size_t source_length) :
+    AsyncWorker(callback, "tree-sitter.matchesAsync"),
+    query_(query),
+    tree_(ts_tree_copy(tree->tree_)),
+    encoding_(tree->encoding_),
+    file_(tree->source_),
+    node_(node),
+    start_point_(start_point),
+    end_point_(end_point),
+    cursor_(Query::AcquireCursor(match_limit)),
+    has_source_(has_source),
+    source_(source),
+    source_length_(source_length),
+    did_exceed_match_limit_(false) {
+    node_.tree = tree_;
+  }
+
+  ~MatchesWorker() {
+    if (cursor_) Query::ReleaseCursor(cursor_);
+    ts_tree_delete(tree_);
+  }
+
+  void Execute() {
+    uint32_t bytes_per_character = BytesPerCharacter(encoding_);
+    ts_query_cursor_set_point_range(cursor_, start_point_, end_point_);
+    ts_query_cursor_exec(cursor_, query_->query_, node_);
+
+    TSQueryMatch match;
+    capture_offsets_.push_back(0);
+    while (ts_query_cursor_next_match(cursor_, &match)) {
+      if (has_source_ && !query_->SatisfiesTextPredicates(
+        match, source_, source_length_, encoding_, Query::EqualityPredicates
+      )) continue;
+
+      patterns_.push_back(match.pattern_index);
+      for (uint16_t i = 0; i < match.capture_count; i++) {
+        captures_.push_back(match.captures[i]);
+        AppendCaptureValues(&values_, match.pattern_index, match.captures[i], bytes_per_character);
+      }
+      capture_offsets_.push_back(captures_.size());
+    }
+
+    did_exceed_match_limit_ = ts_query_cursor_did_exceed_match_limit(cursor_);
+  }
+
+  void HandleOKCallback() {
+    Query::ReleaseCursor(cursor_);
+    cursor_ = nullptr;
+
+    vector<uint32_t> patterns;
+    vector<uint32_t> capture_offsets = {0};
+    vector<uint32_t> values;
+    for (size_t i = 0; i < patterns_.size(); i++) {
+      uint32_t start = capture_offsets_[i];
+      uint32_t end = capture_offsets_[i + 1];
+      TSQueryMatch match = {
+        0,
+        static_cast<uint16_t>(patterns_[i]),
+        static_cast<uint16_t>(end - start),
+        captures_.data() + start,
+      };
+      if (has_source_ && !query_->SatisfiesTextPredicates(
+        match, source_, source_length_, encoding_, Query::RegexPredicates
+      )) continue;
+
+      patterns.push_back(patterns_[i]);
+      values.insert(
+        values.end(),
+        values_.begin() + start * CAPTURE_SIZE,
+        values_.begin() + end * CAPTURE_SIZE
+      );
+      capture_offsets.push_back(values.size() / CAPTURE_SIZE);
+    }
+
+    Local<Object> result = Nan::New<Object>();
+    Nan::Set(result, Nan::New("patterns").ToLocalChecked(), Uint32ArrayFrom(patterns));
+    Nan::Set(result, Nan::New("captureOffsets").ToLocalChecked(), Uint32ArrayFrom(capture_offsets));
+    Nan::Set(result, Nan::New("captures").ToLocalChecked(), Uint32ArrayFrom(values));
+    Nan::Set(result, Nan::New("didExceedMatchLimit").ToLocalChecked(), Nan::New(did_exceed_match_limit_));
+    Local<Value> argv[] = {Nan::Null(), result};
+    callback->Call(2, argv, async_resource);
+  }
+
+ private:
+  Query *query_;
+  TSTree *tree_;
+  TSInputEncoding encoding_;
+  std::shared_ptr<MappedFile> file_;
+  TSNode node_;
+  TSPoint start_point_;
+  TSPoint end_point_;
+  TSQueryCursor *cursor_;
+  bool has_source_;
+  const char *source_;
+  size_t source_length_;
+  bool did_exceed_match_limit_;
+
+  vector<uint32_t> patterns_;
+  vector<uint32_t> capture_offsets_;
+  vector<TSQueryCapture> captures_;
+  vector<uint32_t> values_;
+};
+
+}  // namespace
+
+// Starts running the query on the thread pool, and returns false instead
+// when the query's text predicates can't be checked natively.
+void Query::MatchesAsync(const Nan::FunctionCallbackInfo<Value> &info) {
+  Query *query = Query::UnwrapQuery(info.This());
+  Tree *tree = Tree::UnwrapTree(info[1]);
+  uint32_t start_row    = Nan::To<uint32_t>(info[2]).ToChecked();
+  uint32_t start_column = Nan::To<uint32_t>(info[3]).ToChecked();
+  uint32_t end_row      = Nan::To<uint32_t>(info[4]).ToChecked();
+  uint32_t end_column   = Nan::To<uint32_t>(info[5]).ToChecked();
+
+  if (query == nullptr) {
+    Nan::ThrowError("Missing argument query");
+    return;
+  }
+
+  if (tree == nullptr) {
+    Nan::ThrowError("Missing argument tree");
+    return;
+  }
+
+  start_column *= BytesPerCharacter(tree->encoding_);
+  end_column *= BytesPerCharacter(tree->encoding_);
+
+  const char *source = nullptr;
+  size_t source_length = 0;
+  bool has_source = Query::SourceText(tree, info[6], &source, &source_length);
+  if (!has_source && Nan::To<bool>(info[8]).FromMaybe(false)) {
+    info.GetReturnValue().Set(Nan::False());
+    return;
+  }
+
+  uint32_t match_limit;
+  if (!Query::MatchLimitFromJS(info[7], &match_limit)) return;
+
+  TSNode rootNode = node_methods::UnmarshalNode(tree);
+  TSPoint start_point = {start_row, start_column};
+  TSPoint end_point = {end_row, end_column};
+  auto worker = new MatchesWorker(
+    new Nan::Callback(info[0].As<Function>()),
+    query,
+    tree,
+    rootNode,
+    start_point,
+    end_point,
+    match_limit,
+    has_source,
+    source,
+    source_length
+  );
+
+  // The query and the source text are used on the worker thread, so they
+  // are kept alive until it is done. The tree itself is copied.
+  worker->SaveToPersistent("query", info.This());
+  if (!info[6]->IsUndefined()) worker->SaveToPersistent("source", info[6]);
+
+  Nan::AsyncQueueWorker(worker);
+  info.GetReturnValue().Set(Nan::True());
+}
+
+void Query::IterMatches(const Nan::FunctionCallbackInfo<Value> &info) {
+  Query *query = Query::UnwrapQuery(info.This());
+  Tree *tree = Tree::UnwrapTree(info[0]);
+  uint32_t start_row    = Nan::To<uint32_t>(info[1]).ToChecked();
+  uint32_t start_column = Nan::To<uint32_t>(info[2]).ToChecked();
+  uint32_t end_row      = Nan::To<uint32_t>(info[3]).ToChecked();
+  uint32_t end_column   = Nan::To<uint32_t>(info[4]).ToChecked();
+
+  if (query == nullptr) {
+    Nan::ThrowError("Missing argument query");
+    return;
+  }
+
+  if (tree == nullptr) {
+    Nan::ThrowError("Missing argument tree");
+    return;
+  }
+
+  start_column *= BytesPerCharacter(tree->encoding_);
+  end_column *= BytesPerCharacter(tree->encoding_);
+
+  uint32_t match_limit;
+  if (!Query::MatchLimitFromJS(info[5], &match_limit)) return;
+
+  TSNode rootNode = node_methods::UnmarshalNode(tree);
+  TSPoint start_point = {start_row, start_column};
+  TSPoint end_point = {end_row, end_column};
+  info.GetReturnValue().Set(QueryMatchIterator::NewInstance(
+    query->query_, tree, rootNode, start_point, end_point, match_limit
+  ));
+}
+
+// Whether the last synchronous execution of the query, by `matches`,
+// `captures` or `capturesCompact`, had to drop some of its in-progress
+// matches because it reached its match limit. Iterators and asynchronous
+// executions report their own.
+void Query::DidExceedMatchLimit(const Nan::FunctionCallbackInfo<Value> &info) {
+  Query *query = Query::UnwrapQuery(info.This());
+  if (query == nullptr) return;
+  info.GetReturnValue().Set(Nan::New(query->did_exceed_match_limit_));
+}
 
 }  // namespace node_tree_sitter
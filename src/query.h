@@ -4,31 +4,67 @@
 #include <v8.h>
 #include <nan.h>
 #include <node_object_wrap.h>
+#include <string>
 #include <unordered_map>
+#include <vector>
 #include <tree_sitter/api.h>
 
 namespace node_tree_sitter {
 
+class Tree;
+
 class Query : public Nan::ObjectWrap {
  public:
   static void Init(v8::Local<v8::Object> exports);
   static v8::Local<v8::Value> NewInstance(TSQuery *);
   static Query *UnwrapQuery(const v8::Local<v8::Value> &);
 
+  static TSQueryCursor *AcquireCursor(uint32_t match_limit);
+  static void ReleaseCursor(TSQueryCursor *);
+  static bool MatchLimitFromJS(v8::Local<v8::Value>, uint32_t *);
+  static bool SourceText(const Tree *, v8::Local<v8::Value>, const char **, size_t *);
+  // Which text predicates to check. The equality predicates don't use V8,
+  // so they can also be checked off the main thread.
+  enum TextPredicateSet { AllTextPredicates, EqualityPredicates, RegexPredicates };
+
+  bool SatisfiesTextPredicates(const TSQueryMatch &, const char *, size_t, TSInputEncoding,
+                               TextPredicateSet = AllTextPredicates) const;
+
   TSQuery *query_;
+  bool did_exceed_match_limit_;
 
  private:
+  // An `#eq?`, `#not-eq?` or `#match?` predicate, checked against the source
+  // bytes of the captured nodes without creating any JS objects.
+  struct TextPredicate {
+    enum Kind { EqString, EqCapture, Match };
+
+    Kind kind;
+    bool is_positive;
+    uint32_t capture_id;
+    uint32_t other_capture_id;
+    std::string utf8_value;
+    std::string utf16_value;
+    Nan::Global<v8::RegExp> regex;
+  };
+
   explicit Query(TSQuery *);
   ~Query();
 
+  v8::Local<v8::Array> CompileTextPredicates();
+
   static void New(const Nan::FunctionCallbackInfo<v8::Value> &);
   static void Matches(const Nan::FunctionCallbackInfo<v8::Value> &);
   static void Captures(const Nan::FunctionCallbackInfo<v8::Value> &);
+  static void CapturesCompact(const Nan::FunctionCallbackInfo<v8::Value> &);
+  static void IterMatches(const Nan::FunctionCallbackInfo<v8::Value> &);
+  static void MatchesAsync(const Nan::FunctionCallbackInfo<v8::Value> &);
+  static void DidExceedMatchLimit(const Nan::FunctionCallbackInfo<v8::Value> &);
   static void GetPredicates(const Nan::FunctionCallbackInfo<v8::Value> &);
+  static void GetCaptureNames(const Nan::FunctionCallbackInfo<v8::Value> &);
 
-  static TSQueryCursor *ts_query_cursor;
-  static Nan::Persistent<v8::Function> constructor;
-  static Nan::Persistent<v8::FunctionTemplate> constructor_template;
+  // The text predicates of each pattern, indexed by pattern.
+  std::vector<std::vector<TextPredicate>> text_predicates_;
 };
 
 }  // namespace node_tree_sitter
@@ -0,0 +1,164 @@
+#include "./query_match_iterator.h"
+#include <vector>
+#include <nan.h>
+#include <tree_sitter/api.h>
+#include <v8.h>
+#include "./addon_data.h"
+#include "./node.h"
+#include "./query.h"
+#include "./util.h"
+
+namespace node_tree_sitter {
+
+using std::vector;
+using namespace v8;
+
+static const uint32_t DEFAULT_CHUNK_SIZE = 64;
+
+void QueryMatchIterator::Init(Local<Object> exports) {
+  Local<FunctionTemplate> tpl = Nan::New<FunctionTemplate>(New);
+  Local<String> class_name = Nan::New("QueryMatchIterator").ToLocalChecked();
+  tpl->SetClassName(class_name);
+  tpl->InstanceTemplate()->SetInternalFieldCount(1);
+
+  FunctionPair methods[] = {
+    {"next", Next},
+    {"didExceedMatchLimit", DidExceedMatchLimit},
+  };
+
+  for (size_t i = 0; i < length_of_array(methods); i++) {
+    Nan::SetPrototypeMethod(tpl, methods[i].name, methods[i].callback);
+  }
+
+  AddonData::SetOnce(AddonData::Get()->query_match_iterator_constructor, Nan::GetFunction(tpl).ToLocalChecked());
+}
+
+Local<Value> QueryMatchIterator::NewInstance(TSQuery *query, Tree *tree, TSNode node,
+                                             TSPoint start_point, TSPoint end_point,
+                                             uint32_t match_limit) {
+  Local<Object> self;
+  MaybeLocal<Object> maybe_self = Nan::New(AddonData::Get()->query_match_iterator_constructor)->NewInstance(Nan::GetCurrentContext());
+  if (maybe_self.ToLocal(&self)) {
+    QueryMatchIterator *iterator = new QueryMatchIterator(tree, match_limit);
+    ts_query_cursor_set_point_range(iterator->cursor_, start_point, end_point);
+    ts_query_cursor_exec(iterator->cursor_, query, node);
+    iterator->Wrap(self);
+    return self;
+  } else {
+    return Nan::Null();
+  }
+}
+
+QueryMatchIterator::QueryMatchIterator(Tree *tree, uint32_t match_limit) :
+  cursor_(Query::AcquireCursor(match_limit)),
+  edit_count_(tree->edit_count_),
+  done_(false),
+  did_exceed_match_limit_(false) {}
+
+QueryMatchIterator::~QueryMatchIterator() {
+  if (cursor_) Query::ReleaseCursor(cursor_);
+}
+
+void QueryMatchIterator::New(const Nan::FunctionCallbackInfo<Value> &info) {
+  info.GetReturnValue().Set(Nan::Null());
+}
+
+// Returns the next chunk of matches in the same form as `Query._matches`, or
+// null once there are no more. The query, the tree and the source text are
+// read from the iterator's properties, which also keep them alive.
+void QueryMatchIterator::Next(const Nan::FunctionCallbackInfo<Value> &info) {
+  QueryMatchIterator *iterator = Nan::ObjectWrap::Unwrap<QueryMatchIterator>(info.This());
+  Local<Object> self = info.This();
+  Query *query = Query::UnwrapQuery(Nan::Get(self, Nan::New("query").ToLocalChecked()).ToLocalChecked());
+  Tree *tree = Tree::UnwrapTree(Nan::Get(self, Nan::New("tree").ToLocalChecked()).ToLocalChecked());
+  if (!query || !tree) {
+    Nan::ThrowTypeError("The iterator has no query or tree");
+    return;
+  }
+
+  // Editing a tree replaces some of its subtrees, which would leave the
+  // cursor pointing at stale ones.
+  if (tree->edit_count_ != iterator->edit_count_) {
+    Nan::ThrowError("The tree was edited during the iteration");
+    return;
+  }
+
+  uint32_t chunk_size = DEFAULT_CHUNK_SIZE;
+  if (info.Length() > 0 && !info[0]->IsUndefined()) {
+    chunk_size = Nan::To<uint32_t>(info[0]).FromMaybe(0);
+    if (chunk_size == 0) {
+      Nan::ThrowTypeError("Chunk size must be a positive integer");
+      return;
+    }
+  }
+
+  if (iterator->done_) {
+    info.GetReturnValue().Set(Nan::Null());
+    return;
+  }
+
+  const char *source;
+  size_t source_length;
+  Local<Value> js_source = Nan::Get(self, Nan::New("source").ToLocalChecked()).ToLocalChecked();
+  bool has_source = Query::SourceText(tree, js_source, &source, &source_length);
+
+  TSQuery *ts_query = query->query_;
+  Local<Array> js_matches = Nan::New<Array>();
+  unsigned index = 0;
+  uint32_t match_count = 0;
+  vector<TSNode> nodes;
+  TSQueryMatch match;
+
+  while (match_count < chunk_size) {
+    if (!ts_query_cursor_next_match(iterator->cursor_, &match)) {
+      iterator->done_ = true;
+      break;
+    }
+
+    if (has_source && !query->SatisfiesTextPredicates(match, source, source_length, tree->encoding_)) {
+      continue;
+    }
+
+    Nan::Set(js_matches, index++, Nan::New(match.pattern_index));
+    for (uint16_t i = 0; i < match.capture_count; i++) {
+      const TSQueryCapture &capture = match.captures[i];
+      uint32_t capture_name_len = 0;
+      const char *capture_name = ts_query_capture_name_for_id(
+          ts_query, capture.index, &capture_name_len);
+      nodes.push_back(capture.node);
+      Nan::Set(js_matches, index++, Nan::New(capture_name).ToLocalChecked());
+    }
+    match_count++;
+  }
+
+  iterator->did_exceed_match_limit_ = ts_query_cursor_did_exceed_match_limit(iterator->cursor_);
+
+  // A finished iterator gives its cursor back right away rather than when
+  // it is collected.
+  if (iterator->done_) {
+    Query::ReleaseCursor(iterator->cursor_);
+    iterator->cursor_ = nullptr;
+  }
+
+  if (match_count == 0) {
+    info.GetReturnValue().Set(Nan::Null());
+    return;
+  }
+
+  auto js_nodes = node_methods::GetMarshalNodes(info, tree, nodes.data(), nodes.size());
+
+  auto result = Nan::New<Array>();
+  Nan::Set(result, 0, js_matches);
+  Nan::Set(result, 1, js_nodes);
+  Nan::Set(result, 2, Nan::New(has_source));
+  info.GetReturnValue().Set(result);
+}
+
+// Whether this iteration has had to drop some of its in-progress matches
+// because it reached its match limit, as of the last chunk.
+void QueryMatchIterator::DidExceedMatchLimit(const Nan::FunctionCallbackInfo<Value> &info) {
+  QueryMatchIterator *iterator = Nan::ObjectWrap::Unwrap<QueryMatchIterator>(info.This());
+  info.GetReturnValue().Set(Nan::New(iterator->did_exceed_match_limit_));
+}
+
+}  // namespace node_tree_sitter
@@ -0,0 +1,37 @@
+#ifndef NODE_TREE_SITTER_QUERY_MATCH_ITERATOR_H_
+#define NODE_TREE_SITTER_QUERY_MATCH_ITERATOR_H_
+
+#include <v8.h>
+#include <nan.h>
+#include <node_object_wrap.h>
+#include <tree_sitter/api.h>
+#include "./tree.h"
+
+namespace node_tree_sitter {
+
+// A query execution that returns its matches in chunks. It holds a query
+// cursor from the pool until it is collected, so that any number of
+// iterators can be in progress at once and only one chunk of matches is
+// held at a time.
+class QueryMatchIterator : public Nan::ObjectWrap {
+ public:
+  static void Init(v8::Local<v8::Object> exports);
+  static v8::Local<v8::Value> NewInstance(TSQuery *, Tree *, TSNode, TSPoint, TSPoint, uint32_t match_limit);
+
+ private:
+  explicit QueryMatchIterator(Tree *, uint32_t match_limit);
+  ~QueryMatchIterator();
+
+  static void New(const Nan::FunctionCallbackInfo<v8::Value> &);
+  static void Next(const Nan::FunctionCallbackInfo<v8::Value> &);
+  static void DidExceedMatchLimit(const Nan::FunctionCallbackInfo<v8::Value> &);
+
+  TSQueryCursor *cursor_;
+  uint32_t edit_count_;
+  bool done_;
+  bool did_exceed_match_limit_;
+};
+
+}  // namespace node_tree_sitter
+
+#endif  // NODE_TREE_SITTER_QUERY_MATCH_ITERATOR_H_
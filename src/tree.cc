@@ -1,19 +1,21 @@
 #include "./tree.h"
+#include <algorithm>
+#include <mutex>
 #include <string>
+#include <unordered_map>
+#include <vector>
 #include <v8.h>
 #include <nan.h>
+#include "./addon_data.h"
 #include "./node.h"
 #include "./logger.h"
 #include "./util.h"
 #include "./conversions.h"
+#include "./language.h"
 
 namespace node_tree_sitter {
 
 using namespace v8;
-using node_methods::UnmarshalNodeId;
-
-Nan::Persistent<Function> Tree::constructor;
-Nan::Persistent<FunctionTemplate> Tree::constructor_template;
 
 void Tree::Init(Local<Object> exports) {
   Local<FunctionTemplate> tpl = Nan::New<FunctionTemplate>(New);
@@ -23,50 +25,171 @@ void Tree::Init(Local<Object> exports) {
 
   FunctionPair methods[] = {
     {"edit", Edit},
+    {"editMany", EditMany},
     {"rootNode", RootNode},
     {"printDotGraph", PrintDotGraph},
     {"getChangedRanges", GetChangedRanges},
     {"getEditedRange", GetEditedRange},
-    {"_cacheNode", CacheNode},
-    {"_cacheNodes", CacheNodes},
+    {"_sourceText", SourceText},
+    {"toFlatArrays", ToFlatArrays},
+    {"share", Share},
+    {"releaseNodes", ReleaseNodes},
+  };
+
+  GetterPair getters[] = {
+    {"encoding", Encoding},
   };
 
   for (size_t i = 0; i < length_of_array(methods); i++) {
     Nan::SetPrototypeMethod(tpl, methods[i].name, methods[i].callback);
   }
 
-  Local<Function> ctor = Nan::GetFunction(tpl).ToLocalChecked();
+  for (size_t i = 0; i < length_of_array(getters); i++) {
+    Nan::SetAccessor(
+      tpl->InstanceTemplate(),
+      Nan::New(getters[i].name).ToLocalChecked(),
+      getters[i].callback);
+  }
 
-  constructor_template.Reset(tpl);
-  constructor.Reset(ctor);
-  Nan::Set(exports, class_name, ctor);
+  Local<Function> ctor = Nan::GetFunction(tpl).ToLocalChecked();
+  Nan::Set(
+    ctor,
+    Nan::New("fromShared").ToLocalChecked(),
+    Nan::GetFunction(Nan::New<FunctionTemplate>(FromShared)).ToLocalChecked()
+  );
+
+  AddonData *data = AddonData::Get();
+  AddonData::SetOnce(data->tree_constructor_template, tpl);
+  AddonData::SetOnce(data->tree_constructor, ctor);
+  Nan::Set(exports, class_name, Nan::New(data->tree_constructor));
 }
 
-Tree::Tree(TSTree *tree) : tree_(tree) {}
+Tree::Tree(TSTree *tree, TSInputEncoding encoding) : tree_(tree), encoding_(encoding), edit_count_(0) {}
 
 Tree::~Tree() {
   ts_tree_delete(tree_);
-  for (auto &entry : cached_nodes_) {
-    entry.second->tree = nullptr;
+}
+
+NodeSlotTable::NodeSlotTable() : ids_(64, nullptr), slots_(64), size_(0) {}
+
+static inline size_t hash_node_id(const void *id) {
+  uint64_t hash = reinterpret_cast<uintptr_t>(id);
+  hash ^= hash >> 33;
+  hash *= 0xff51afd7ed558ccdULL;
+  hash ^= hash >> 33;
+  return static_cast<size_t>(hash);
+}
+
+bool NodeSlotTable::Find(const void *id, uint32_t *slot) const {
+  size_t mask = ids_.size() - 1;
+  for (size_t i = hash_node_id(id) & mask; ids_[i]; i = (i + 1) & mask) {
+    if (ids_[i] == id) {
+      *slot = slots_[i];
+      return true;
+    }
+  }
+  return false;
+}
+
+void NodeSlotTable::Insert(const void *id, uint32_t slot) {
+  if (2 * (size_ + 1) > ids_.size()) Grow();
+  size_t mask = ids_.size() - 1;
+  size_t i = hash_node_id(id) & mask;
+  while (ids_[i]) i = (i + 1) & mask;
+  ids_[i] = id;
+  slots_[i] = slot;
+  size_++;
+}
+
+void NodeSlotTable::Clear() {
+  ids_.assign(64, nullptr);
+  slots_.assign(64, 0);
+  size_ = 0;
+}
+
+void NodeSlotTable::Grow() {
+  std::vector<const void *> ids(ids_.size() * 2, nullptr);
+  std::vector<uint32_t> slots(slots_.size() * 2);
+  ids.swap(ids_);
+  slots.swap(slots_);
+  size_ = 0;
+  for (size_t i = 0; i < ids.size(); i++) {
+    if (ids[i]) Insert(ids[i], slots[i]);
+  }
+}
+
+// Returns the node's slot, adding the node to the table if JS hasn't seen it.
+uint32_t Tree::NodeSlot(TSNode node) {
+  uint32_t slot;
+  if (node_slots_.Find(node.id, &slot)) return slot;
+  slot = node_ids_.size();
+  node_ids_.push_back(node.id);
+  for (unsigned i = 0; i < 4; i++) node_contexts_[i].push_back(node.context[i]);
+  node_slots_.Insert(node.id, slot);
+  return slot;
+}
+
+TSNode Tree::NodeAt(uint32_t slot) const {
+  TSNode result = {{0, 0, 0, 0}, nullptr, tree_};
+  if (slot < node_ids_.size()) {
+    result.id = node_ids_[slot];
+    for (unsigned i = 0; i < 4; i++) result.context[i] = node_contexts_[i][slot];
   }
+  return result;
 }
 
-Local<Value> Tree::NewInstance(TSTree *tree) {
+// Applies `ts_node_edit` for each of the edits, in order, to every node in
+// the table. Each node's context is loaded and stored once, however many
+// edits there are. The first three context fields are the node's start
+// byte, row and column.
+void Tree::EditNodes(const TSInputEdit *edits, size_t edit_count) {
+  uint32_t *start_bytes = node_contexts_[0].data();
+  uint32_t *start_rows = node_contexts_[1].data();
+  uint32_t *start_columns = node_contexts_[2].data();
+  for (size_t i = 0, n = node_ids_.size(); i < n; i++) {
+    uint32_t start_byte = start_bytes[i];
+    uint32_t start_row = start_rows[i];
+    uint32_t start_column = start_columns[i];
+    for (size_t j = 0; j < edit_count; j++) {
+      const TSInputEdit &edit = edits[j];
+      if (start_byte >= edit.old_end_byte) {
+        start_byte = edit.new_end_byte + (start_byte - edit.old_end_byte);
+        if (start_row > edit.old_end_point.row) {
+          start_row = edit.new_end_point.row + (start_row - edit.old_end_point.row);
+        } else {
+          start_row = edit.new_end_point.row;
+          start_column = edit.new_end_point.column + (start_column - edit.old_end_point.column);
+        }
+      } else if (start_byte > edit.start_byte) {
+        start_byte = edit.new_end_byte;
+        start_row = edit.new_end_point.row;
+        start_column = edit.new_end_point.column;
+      }
+    }
+    start_bytes[i] = start_byte;
+    start_rows[i] = start_row;
+    start_columns[i] = start_column;
+  }
+}
+
+Local<Value> Tree::NewInstance(TSTree *tree, TSInputEncoding encoding, std::shared_ptr<MappedFile> source) {
   if (tree) {
     Local<Object> self;
-    MaybeLocal<Object> maybe_self = Nan::NewInstance(Nan::New(constructor));
+    MaybeLocal<Object> maybe_self = Nan::NewInstance(Nan::New(AddonData::Get()->tree_constructor));
     if (maybe_self.ToLocal(&self)) {
-      (new Tree(tree))->Wrap(self);
+      Tree *wrapper = new Tree(tree, encoding);
+      wrapper->source_ = std::move(source);
+      wrapper->Wrap(self);
       return self;
     }
   }
   return Nan::Null();
 }
 
-const Tree *Tree::UnwrapTree(const Local<Value> &value) {
+Tree *Tree::UnwrapTree(const Local<Value> &value) {
   if (!value->IsObject()) return nullptr;
   Local<Object> js_tree = Local<Object>::Cast(value);
-  if (!Nan::New(constructor_template)->HasInstance(js_tree)) return nullptr;
+  if (!Nan::New(AddonData::Get()->tree_constructor_template)->HasInstance(js_tree)) return nullptr;
   return ObjectWrap::Unwrap<Tree>(js_tree);
 }
 
@@ -82,7 +205,7 @@ void Tree::New(const Nan::FunctionCallbackInfo<Value> &info) {}
 
 #define read_byte_count_from_js(out, value, name)   \
   read_number_from_js(out, value, name);            \
-  (*out) *= 2
+  (*out) *= BytesPerCharacter(tree->encoding_)
 
 void Tree::Edit(const Nan::FunctionCallbackInfo<Value> &info) {
   Tree *tree = ObjectWrap::Unwrap<Tree>(info.This());
@@ -100,28 +223,61 @@ void Tree::Edit(const Nan::FunctionCallbackInfo<Value> &info) {
   read_byte_count_from_js(&edit.new_end_byte, info[8], "newEndIndex");
 
   ts_tree_edit(tree->tree_, &edit);
+  tree->EditNodes(&edit, 1);
+  tree->edit_count_++;
 
-  for (auto &entry : tree->cached_nodes_) {
-    Local<Object> js_node = Nan::New(entry.second->node);
-    TSNode node;
-    node.id = entry.first;
-    for (unsigned i = 0; i < 4; i++) {
-      Local<Value> node_field;
-      if (Nan::Get(js_node, i + 2).ToLocal(&node_field)) {
-        node.context[i] = Nan::To<uint32_t>(node_field).FromMaybe(0);
-      }
-    }
+  info.GetReturnValue().Set(info.This());
+}
 
-    ts_node_edit(&node, &edit);
+void Tree::EditMany(const Nan::FunctionCallbackInfo<Value> &info) {
+  Tree *tree = ObjectWrap::Unwrap<Tree>(info.This());
 
-    for (unsigned i = 0; i < 4; i++) {
-      Nan::Set(js_node, i + 2, Nan::New(node.context[i]));
-    }
+  if (!info[0]->IsUint32Array()) {
+    Nan::ThrowTypeError("Edits must be packed into a Uint32Array");
+    return;
+  }
+
+  Nan::TypedArrayContents<uint32_t> packed(info[0]);
+  if (packed.length() % 9 != 0) {
+    Nan::ThrowRangeError("Packed edits must have nine values per edit");
+    return;
   }
 
+  // The values are in the same order as the arguments to `edit`.
+  uint32_t bytes_per_character = BytesPerCharacter(tree->encoding_);
+  std::vector<TSInputEdit> edits(packed.length() / 9);
+  for (size_t i = 0; i < edits.size(); i++) {
+    const uint32_t *values = *packed + i * 9;
+    TSInputEdit &edit = edits[i];
+    edit.start_point = {values[0], values[1] * bytes_per_character};
+    edit.old_end_point = {values[2], values[3] * bytes_per_character};
+    edit.new_end_point = {values[4], values[5] * bytes_per_character};
+    edit.start_byte = values[6] * bytes_per_character;
+    edit.old_end_byte = values[7] * bytes_per_character;
+    edit.new_end_byte = values[8] * bytes_per_character;
+    ts_tree_edit(tree->tree_, &edit);
+  }
+
+  // The nodes that JS holds are updated in a single pass over the table.
+  tree->EditNodes(edits.data(), edits.size());
+  tree->edit_count_++;
+
   info.GetReturnValue().Set(info.This());
 }
 
+// Empties the node table. JS detaches the nodes it was holding first, so
+// that none of them refers to a slot that is handed out again.
+void Tree::ReleaseNodes(const Nan::FunctionCallbackInfo<Value> &info) {
+  Tree *tree = ObjectWrap::Unwrap<Tree>(info.This());
+  tree->node_ids_.clear();
+  tree->node_ids_.shrink_to_fit();
+  for (unsigned i = 0; i < 4; i++) {
+    tree->node_contexts_[i].clear();
+    tree->node_contexts_[i].shrink_to_fit();
+  }
+  tree->node_slots_.Clear();
+}
+
 void Tree::RootNode(const Nan::FunctionCallbackInfo<Value> &info) {
   Tree *tree = ObjectWrap::Unwrap<Tree>(info.This());
   node_methods::MarshalNode(info, tree, ts_tree_root_node(tree->tree_));
@@ -140,7 +296,7 @@ void Tree::GetChangedRanges(const Nan::FunctionCallbackInfo<Value> &info) {
 
   Local<Array> result = Nan::New<Array>();
   for (size_t i = 0; i < range_count; i++) {
-    Nan::Set(result, i, RangeToJS(ranges[i]));
+    Nan::Set(result, i, RangeToJS(ranges[i], tree->encoding_));
   }
 
   info.GetReturnValue().Set(result);
@@ -191,7 +347,12 @@ void Tree::GetEditedRange(const Nan::FunctionCallbackInfo<Value> &info) {
   }
 
   ts_tree_cursor_delete(&cursor);
-  info.GetReturnValue().Set(RangeToJS(result));
+  info.GetReturnValue().Set(RangeToJS(result, tree->encoding_));
+}
+
+void Tree::Encoding(v8::Local<v8::String> prop, const Nan::PropertyCallbackInfo<v8::Value> &info) {
+  Tree *tree = ObjectWrap::Unwrap<Tree>(info.This());
+  info.GetReturnValue().Set(EncodingToJS(tree->encoding_));
 }
 
 void Tree::PrintDotGraph(const Nan::FunctionCallbackInfo<Value> &info) {
@@ -200,54 +361,207 @@ void Tree::PrintDotGraph(const Nan::FunctionCallbackInfo<Value> &info) {
   info.GetReturnValue().Set(info.This());
 }
 
-static void FinalizeNode(const v8::WeakCallbackInfo<Tree::NodeCacheEntry> &info) {
-  Tree::NodeCacheEntry *cache_entry = info.GetParameter();
-  assert(!cache_entry->node.IsEmpty());
-  cache_entry->node.Reset();
-  if (cache_entry->tree) {
-    assert(cache_entry->tree->cached_nodes_.count(cache_entry->key));
-    cache_entry->tree->cached_nodes_.erase(cache_entry->key);
+void Tree::SourceText(const Nan::FunctionCallbackInfo<Value> &info) {
+  Tree *tree = ObjectWrap::Unwrap<Tree>(info.This());
+  if (!tree->source_) {
+    Nan::ThrowError("The tree was not parsed from a file");
+    return;
+  }
+
+  uint32_t bytes_per_character = BytesPerCharacter(tree->encoding_);
+  size_t length = tree->source_->length() / bytes_per_character;
+  size_t start = std::min<size_t>(Nan::To<uint32_t>(info[0]).FromMaybe(0), length);
+  size_t end = std::min<size_t>(Nan::To<uint32_t>(info[1]).FromMaybe(0), length);
+  if (end < start) end = start;
+
+  const char *data = tree->source_->data() + start * bytes_per_character;
+  if (tree->encoding_ == TSInputEncodingUTF8) {
+    info.GetReturnValue().Set(Nan::New(data, end - start).ToLocalChecked());
+  } else {
+    info.GetReturnValue().Set(String::NewFromTwoByte(
+      info.GetIsolate(),
+      reinterpret_cast<const uint16_t *>(data),
+      NewStringType::kNormal,
+      end - start
+    ).ToLocalChecked());
   }
-  delete cache_entry;
 }
 
-static void CacheNodeForTree(Tree *tree, Isolate *isolate, Local<Object> js_node) {
-  Local<Value> js_node_field1, js_node_field2;
-  if (!Nan::Get(js_node, 0).ToLocal(&js_node_field1)) return;
-  if (!Nan::Get(js_node, 1).ToLocal(&js_node_field2)) return;
-  uint32_t key_parts[2] = {
-    Nan::To<uint32_t>(js_node_field1).FromMaybe(0),
-    Nan::To<uint32_t>(js_node_field2).FromMaybe(0)
-  };
-  const void *key = UnmarshalNodeId(key_parts);
+// Copies a column into a new JS typed array of the matching element type.
+template <typename ArrayType, typename T>
+static Local<ArrayType> ColumnToJS(const std::vector<T> &column) {
+  const char *data = reinterpret_cast<const char *>(column.data());
+  Local<Object> buffer = Nan::CopyBuffer(data, column.size() * sizeof(T)).ToLocalChecked();
+  Local<Uint8Array> bytes = buffer.As<Uint8Array>();
+  return ArrayType::New(bytes->Buffer(), bytes->ByteOffset(), column.size());
+}
 
-  auto cache_entry = new Tree::NodeCacheEntry{tree, key, {}};
-  cache_entry->node.Reset(isolate, js_node);
-  cache_entry->node.SetWeak(cache_entry, &FinalizeNode, Nan::WeakCallbackType::kParameter);
+void Tree::ToFlatArrays(const Nan::FunctionCallbackInfo<Value> &info) {
+  Tree *tree = ObjectWrap::Unwrap<Tree>(info.This());
+  bool named_only = Nan::To<bool>(info[0]).FromMaybe(false);
+  bool include_fields = Nan::To<bool>(info[1]).FromMaybe(false);
+  uint32_t bytes_per_character = BytesPerCharacter(tree->encoding_);
+
+  std::vector<uint16_t> type_ids, field_ids;
+  std::vector<uint32_t> start_indices, end_indices;
+  std::vector<uint32_t> start_rows, start_columns, end_rows, end_columns;
+  std::vector<int32_t> parents;
+  std::vector<uint32_t> child_counts;
+  std::vector<uint8_t> flags;
+
+  // The nodes are visited in preorder with a single cursor. `ancestors` holds,
+  // for each level of the cursor, the row of the nearest ancestor that made it
+  // into the table, so that skipped anonymous nodes are transparent.
+  std::vector<int32_t> ancestors;
+  TSTreeCursor cursor = ts_tree_cursor_new(ts_tree_root_node(tree->tree_));
+  for (;;) {
+    TSNode node = ts_tree_cursor_current_node(&cursor);
+    int32_t parent = ancestors.empty() ? -1 : ancestors.back();
+    int32_t row = parent;
+
+    bool is_named = ts_node_is_named(node);
+    if (is_named || !named_only) {
+      row = static_cast<int32_t>(type_ids.size());
+      TSPoint start = ts_node_start_point(node);
+      TSPoint end = ts_node_end_point(node);
+      type_ids.push_back(ts_node_symbol(node));
+      if (include_fields) field_ids.push_back(ts_tree_cursor_current_field_id(&cursor));
+      start_indices.push_back(ts_node_start_byte(node) / bytes_per_character);
+      end_indices.push_back(ts_node_end_byte(node) / bytes_per_character);
+      start_rows.push_back(start.row);
+      start_columns.push_back(start.column / bytes_per_character);
+      end_rows.push_back(end.row);
+      end_columns.push_back(end.column / bytes_per_character);
+      parents.push_back(parent);
+      child_counts.push_back(0);
+      flags.push_back(node_methods::NodeFlags(node));
+      if (parent >= 0) child_counts[parent]++;
+    }
+
+    if (ts_tree_cursor_goto_first_child(&cursor)) {
+      ancestors.push_back(row);
+      continue;
+    }
 
-  assert(!tree->cached_nodes_.count(key));
+    bool done = false;
+    while (!ts_tree_cursor_goto_next_sibling(&cursor)) {
+      if (!ts_tree_cursor_goto_parent(&cursor)) {
+        done = true;
+        break;
+      }
+      ancestors.pop_back();
+    }
+    if (done) break;
+  }
+  ts_tree_cursor_delete(&cursor);
+
+  Local<Object> result = Nan::New<Object>();
+  Nan::Set(result, Nan::New("length").ToLocalChecked(), Nan::New<Number>(type_ids.size()));
+  Nan::Set(result, Nan::New("typeId").ToLocalChecked(), ColumnToJS<Uint16Array>(type_ids));
+  if (include_fields) {
+    Nan::Set(result, Nan::New("fieldId").ToLocalChecked(), ColumnToJS<Uint16Array>(field_ids));
+  }
+  Nan::Set(result, Nan::New("startIndex").ToLocalChecked(), ColumnToJS<Uint32Array>(start_indices));
+  Nan::Set(result, Nan::New("endIndex").ToLocalChecked(), ColumnToJS<Uint32Array>(end_indices));
+  Nan::Set(result, Nan::New("startRow").ToLocalChecked(), ColumnToJS<Uint32Array>(start_rows));
+  Nan::Set(result, Nan::New("startColumn").ToLocalChecked(), ColumnToJS<Uint32Array>(start_columns));
+  Nan::Set(result, Nan::New("endRow").ToLocalChecked(), ColumnToJS<Uint32Array>(end_rows));
+  Nan::Set(result, Nan::New("endColumn").ToLocalChecked(), ColumnToJS<Uint32Array>(end_columns));
+  Nan::Set(result, Nan::New("parent").ToLocalChecked(), ColumnToJS<Int32Array>(parents));
+  Nan::Set(result, Nan::New("childCount").ToLocalChecked(), ColumnToJS<Uint32Array>(child_counts));
+  Nan::Set(result, Nan::New("flags").ToLocalChecked(), ColumnToJS<Uint8Array>(flags));
+  info.GetReturnValue().Set(result);
+}
 
-  tree->cached_nodes_[key] = cache_entry;
+#if V8_MAJOR_VERSION >= 8
+
+// A copy of a tree that has been shared between threads. JS holds it as a
+// SharedArrayBuffer, which can be posted to other workers, and the copy is
+// deleted along with the last reference to that buffer, on whichever thread
+// that happens. The registry maps each buffer's data to its shared tree, so
+// that `fromShared` only accepts buffers that were made by `share`.
+struct SharedTree {
+  TSTree *tree;
+  TSInputEncoding encoding;
+  std::shared_ptr<MappedFile> source;
+};
+
+static std::mutex shared_trees_mutex;
+static std::unordered_map<const void *, SharedTree *> shared_trees;
+
+static void DeleteSharedTree(void *data, size_t length, void *deleter_data) {
+  SharedTree *shared_tree = static_cast<SharedTree *>(deleter_data);
+  {
+    std::lock_guard<std::mutex> lock(shared_trees_mutex);
+    shared_trees.erase(data);
+  }
+  ts_tree_delete(shared_tree->tree);
+  delete shared_tree;
+  free(data);
 }
 
-void Tree::CacheNode(const Nan::FunctionCallbackInfo<Value> &info) {
+void Tree::Share(const Nan::FunctionCallbackInfo<Value> &info) {
   Tree *tree = ObjectWrap::Unwrap<Tree>(info.This());
-  Isolate *isolate = info.GetIsolate();
-  Local<Object> js_node = Local<Object>::Cast(info[0]);
+  SharedTree *shared_tree = new SharedTree{ts_tree_copy(tree->tree_), tree->encoding_, tree->source_};
 
-  CacheNodeForTree(tree, isolate, js_node);
+  // The buffer's contents are unused; only the identity of its data matters.
+  void *data = calloc(1, sizeof(uint32_t));
+  {
+    std::lock_guard<std::mutex> lock(shared_trees_mutex);
+    shared_trees[data] = shared_tree;
+  }
+
+  auto backing_store = SharedArrayBuffer::NewBackingStore(data, sizeof(uint32_t), DeleteSharedTree, shared_tree);
+  info.GetReturnValue().Set(SharedArrayBuffer::New(info.GetIsolate(), std::move(backing_store)));
 }
 
-void Tree::CacheNodes(const Nan::FunctionCallbackInfo<Value> &info) {
-  Tree *tree = ObjectWrap::Unwrap<Tree>(info.This());
-  Isolate *isolate = info.GetIsolate();
-  Local<Array> js_nodes = Local<Array>::Cast(info[0]);
-  uint32_t length = js_nodes->Length();
+void Tree::FromShared(const Nan::FunctionCallbackInfo<Value> &info) {
+  if (!info[0]->IsSharedArrayBuffer()) {
+    Nan::ThrowTypeError("Argument must be a shared tree");
+    return;
+  }
+
+  const TSLanguage *language = language_methods::UnwrapLanguage(info[1]);
+  if (!language) return;
+
+  const void *data = info[0].As<SharedArrayBuffer>()->GetBackingStore()->Data();
+  TSTree *copy = nullptr;
+  TSInputEncoding encoding;
+  std::shared_ptr<MappedFile> source;
+  {
+    std::lock_guard<std::mutex> lock(shared_trees_mutex);
+    auto entry = shared_trees.find(data);
+    if (entry != shared_trees.end()) {
+      copy = ts_tree_copy(entry->second->tree);
+      encoding = entry->second->encoding;
+      source = entry->second->source;
+    }
+  }
 
-  for (uint32_t i = 0; i < length; i++) {
-    auto js_node = Local<Object>::Cast(Nan::Get(js_nodes, i).ToLocalChecked());
-    CacheNodeForTree(tree, isolate, js_node);
+  if (!copy) {
+    Nan::ThrowTypeError("Argument must be a shared tree");
+    return;
+  }
+
+  if (ts_tree_language(copy) != language) {
+    ts_tree_delete(copy);
+    Nan::ThrowError("The shared tree was parsed with a different language");
+    return;
   }
+
+  info.GetReturnValue().Set(NewInstance(copy, encoding, std::move(source)));
 }
 
+#else
+
+void Tree::Share(const Nan::FunctionCallbackInfo<Value> &info) {
+  Nan::ThrowError("Sharing trees requires a newer version of Node");
+}
+
+void Tree::FromShared(const Nan::FunctionCallbackInfo<Value> &info) {
+  Nan::ThrowError("Sharing trees requires a newer version of Node");
+}
+
+#endif
+
 }  // namespace node_tree_sitter
@@ -4,41 +4,72 @@
 #include <v8.h>
 #include <nan.h>
 #include <node_object_wrap.h>
-#include <unordered_map>
+#include <memory>
+#include <vector>
 #include <tree_sitter/api.h>
+#include "./mapped_file.h"
 
 namespace node_tree_sitter {
 
+// Maps node ids to slots in a tree's node table, using open addressing with
+// linear probing. Entries are only removed all at once, when JS releases the
+// tree's nodes.
+class NodeSlotTable {
+ public:
+  NodeSlotTable();
+  bool Find(const void *id, uint32_t *slot) const;
+  void Insert(const void *id, uint32_t slot);
+  void Clear();
+
+ private:
+  void Grow();
+
+  std::vector<const void *> ids_;
+  std::vector<uint32_t> slots_;
+  size_t size_;
+};
+
 class Tree : public Nan::ObjectWrap {
  public:
   static void Init(v8::Local<v8::Object> exports);
-  static v8::Local<v8::Value> NewInstance(TSTree *);
-  static const Tree *UnwrapTree(const v8::Local<v8::Value> &);
+  static v8::Local<v8::Value> NewInstance(TSTree *, TSInputEncoding, std::shared_ptr<MappedFile> source = nullptr);
+  static Tree *UnwrapTree(const v8::Local<v8::Value> &);
 
-  struct NodeCacheEntry {
-    Tree *tree;
-    const void *key;
-    v8::Persistent<v8::Object> node;
-  };
+  uint32_t NodeSlot(TSNode);
+  TSNode NodeAt(uint32_t slot) const;
+  void EditNodes(const TSInputEdit *, size_t edit_count);
 
   TSTree *tree_;
-  std::unordered_map<const void *, NodeCacheEntry *> cached_nodes_;
+  TSInputEncoding encoding_;
+  std::shared_ptr<MappedFile> source_;
+  uint32_t edit_count_;
+
+  // The nodes that have been handed out to JS. A JS node holds only its slot
+  // number; the node's id and context are stored here, one array per field,
+  // so that edits can update every node in a single loop. The table grows
+  // until JS releases the tree's nodes, which empties it.
+  std::vector<const void *> node_ids_;
+  std::vector<uint32_t> node_contexts_[4];
+  NodeSlotTable node_slots_;
 
  private:
-  explicit Tree(TSTree *);
+  explicit Tree(TSTree *, TSInputEncoding);
   ~Tree();
 
   static void New(const Nan::FunctionCallbackInfo<v8::Value> &);
   static void Edit(const Nan::FunctionCallbackInfo<v8::Value> &);
+  static void EditMany(const Nan::FunctionCallbackInfo<v8::Value> &);
   static void RootNode(const Nan::FunctionCallbackInfo<v8::Value> &);
   static void PrintDotGraph(const Nan::FunctionCallbackInfo<v8::Value> &);
   static void GetEditedRange(const Nan::FunctionCallbackInfo<v8::Value> &);
   static void GetChangedRanges(const Nan::FunctionCallbackInfo<v8::Value> &);
-  static void CacheNode(const Nan::FunctionCallbackInfo<v8::Value> &);
-  static void CacheNodes(const Nan::FunctionCallbackInfo<v8::Value> &);
+  static void SourceText(const Nan::FunctionCallbackInfo<v8::Value> &);
+  static void ToFlatArrays(const Nan::FunctionCallbackInfo<v8::Value> &);
+  static void Share(const Nan::FunctionCallbackInfo<v8::Value> &);
+  static void ReleaseNodes(const Nan::FunctionCallbackInfo<v8::Value> &);
+  static void FromShared(const Nan::FunctionCallbackInfo<v8::Value> &);
 
-  static Nan::Persistent<v8::Function> constructor;
-  static Nan::Persistent<v8::FunctionTemplate> constructor_template;
+  static void Encoding(v8::Local<v8::String>, const Nan::PropertyCallbackInfo<v8::Value> &);
 };
 
 }  // namespace node_tree_sitter
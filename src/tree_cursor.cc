@@ -2,6 +2,7 @@
 #include <nan.h>
 #include <tree_sitter/api.h>
 #include <v8.h>
+#include "./addon_data.h"
 #include "./util.h"
 #include "./conversions.h"
 #include "./node.h"
@@ -11,8 +12,6 @@ namespace node_tree_sitter {
 
 using namespace v8;
 
-Nan::Persistent<Function> TreeCursor::constructor;
-
 void TreeCursor::Init(v8::Local<v8::Object> exports) {
   Local<FunctionTemplate> tpl = Nan::New<FunctionTemplate>(New);
   Local<String> class_name = Nan::New("TreeCursor").ToLocalChecked();
@@ -50,22 +49,23 @@ void TreeCursor::Init(v8::Local<v8::Object> exports) {
   }
 
   Local<Function> constructor_local = Nan::GetFunction(tpl).ToLocalChecked();
-  Nan::Set(exports, class_name, constructor_local);
-  constructor.Reset(Nan::Persistent<Function>(constructor_local));
+  AddonData *data = AddonData::Get();
+  AddonData::SetOnce(data->tree_cursor_constructor, constructor_local);
+  Nan::Set(exports, class_name, Nan::New(data->tree_cursor_constructor));
 }
 
-Local<Value> TreeCursor::NewInstance(TSTreeCursor cursor) {
+Local<Value> TreeCursor::NewInstance(TSTreeCursor cursor, TSInputEncoding encoding) {
   Local<Object> self;
-  MaybeLocal<Object> maybe_self = Nan::New(constructor)->NewInstance(Nan::GetCurrentContext());
+  MaybeLocal<Object> maybe_self = Nan::New(AddonData::Get()->tree_cursor_constructor)->NewInstance(Nan::GetCurrentContext());
   if (maybe_self.ToLocal(&self)) {
-    (new TreeCursor(cursor))->Wrap(self);
+    (new TreeCursor(cursor, encoding))->Wrap(self);
     return self;
   } else {
     return Nan::Null();
   }
 }
 
-TreeCursor::TreeCursor(TSTreeCursor cursor) : cursor_(cursor) {}
+TreeCursor::TreeCursor(TSTreeCursor cursor, TSInputEncoding encoding) : cursor_(cursor), encoding_(encoding) {}
 
 TreeCursor::~TreeCursor() { ts_tree_cursor_delete(&cursor_); }
 
@@ -92,7 +92,7 @@ void TreeCursor::GotoFirstChildForIndex(const Nan::FunctionCallbackInfo<Value> &
     Nan::ThrowTypeError("Argument must be an integer");
     return;
   }
-  uint32_t goal_byte = maybe_index.FromJust() * 2;
+  uint32_t goal_byte = maybe_index.FromJust() * BytesPerCharacter(cursor->encoding_);
   int64_t child_index = ts_tree_cursor_goto_first_child_for_byte(&cursor->cursor_, goal_byte);
   if (child_index < 0) {
     info.GetReturnValue().Set(Nan::Null());
@@ -110,19 +110,19 @@ void TreeCursor::GotoNextSibling(const Nan::FunctionCallbackInfo<Value> &info) {
 void TreeCursor::StartPosition(const Nan::FunctionCallbackInfo<Value> &info) {
   TreeCursor *cursor = Nan::ObjectWrap::Unwrap<TreeCursor>(info.This());
   TSNode node = ts_tree_cursor_current_node(&cursor->cursor_);
-  TransferPoint(ts_node_start_point(node));
+  TransferPoint(ts_node_start_point(node), cursor->encoding_);
 }
 
 void TreeCursor::EndPosition(const Nan::FunctionCallbackInfo<Value> &info) {
   TreeCursor *cursor = Nan::ObjectWrap::Unwrap<TreeCursor>(info.This());
   TSNode node = ts_tree_cursor_current_node(&cursor->cursor_);
-  TransferPoint(ts_node_end_point(node));
+  TransferPoint(ts_node_end_point(node), cursor->encoding_);
 }
 
 void TreeCursor::CurrentNode(const Nan::FunctionCallbackInfo<Value> &info) {
   TreeCursor *cursor = Nan::ObjectWrap::Unwrap<TreeCursor>(info.This());
   Local<String> key = Nan::New<String>("tree").ToLocalChecked();
-  const Tree *tree = Tree::UnwrapTree(Nan::Get(info.This(), key).ToLocalChecked());
+  Tree *tree = Tree::UnwrapTree(Nan::Get(info.This(), key).ToLocalChecked());
   TSNode node = ts_tree_cursor_current_node(&cursor->cursor_);
   node_methods::MarshalNode(info, tree, node);
 }
@@ -130,7 +130,7 @@ void TreeCursor::CurrentNode(const Nan::FunctionCallbackInfo<Value> &info) {
 void TreeCursor::Reset(const Nan::FunctionCallbackInfo<Value> &info) {
   TreeCursor *cursor = Nan::ObjectWrap::Unwrap<TreeCursor>(info.This());
   Local<String> key = Nan::New<String>("tree").ToLocalChecked();
-  const Tree *tree = Tree::UnwrapTree(Nan::Get(info.This(), key).ToLocalChecked());
+  Tree *tree = Tree::UnwrapTree(Nan::Get(info.This(), key).ToLocalChecked());
   TSNode node = node_methods::UnmarshalNode(tree);
   ts_tree_cursor_reset(&cursor->cursor_, node);
 }
@@ -159,13 +159,13 @@ void TreeCursor::CurrentFieldName(v8::Local<v8::String> prop, const Nan::Propert
 void TreeCursor::StartIndex(v8::Local<v8::String> prop, const Nan::PropertyCallbackInfo<v8::Value> &info) {
   TreeCursor *cursor = Nan::ObjectWrap::Unwrap<TreeCursor>(info.This());
   TSNode node = ts_tree_cursor_current_node(&cursor->cursor_);
-  info.GetReturnValue().Set(ByteCountToJS(ts_node_start_byte(node)));
+  info.GetReturnValue().Set(ByteCountToJS(ts_node_start_byte(node), cursor->encoding_));
 }
 
 void TreeCursor::EndIndex(v8::Local<v8::String> prop, const Nan::PropertyCallbackInfo<v8::Value> &info) {
   TreeCursor *cursor = Nan::ObjectWrap::Unwrap<TreeCursor>(info.This());
   TSNode node = ts_tree_cursor_current_node(&cursor->cursor_);
-  info.GetReturnValue().Set(ByteCountToJS(ts_node_end_byte(node)));
+  info.GetReturnValue().Set(ByteCountToJS(ts_node_end_byte(node), cursor->encoding_));
 }
 
 }
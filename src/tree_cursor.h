@@ -11,10 +11,10 @@ namespace node_tree_sitter {
 class TreeCursor : public Nan::ObjectWrap {
  public:
   static void Init(v8::Local<v8::Object> exports);
-  static v8::Local<v8::Value> NewInstance(TSTreeCursor);
+  static v8::Local<v8::Value> NewInstance(TSTreeCursor, TSInputEncoding);
 
  private:
-  explicit TreeCursor(TSTreeCursor);
+  explicit TreeCursor(TSTreeCursor, TSInputEncoding);
   ~TreeCursor();
 
   static void New(const Nan::FunctionCallbackInfo<v8::Value> &);
@@ -34,8 +34,7 @@ class TreeCursor : public Nan::ObjectWrap {
   static void EndIndex(v8::Local<v8::String>, const Nan::PropertyCallbackInfo<v8::Value> &);
 
   TSTreeCursor cursor_;
-  static Nan::Persistent<v8::Function> constructor;
-  static Nan::Persistent<v8::FunctionTemplate> constructor_template;
+  TSInputEncoding encoding_;
 };
 
 }  // namespace node_tree_sitter
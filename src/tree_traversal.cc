@@ -0,0 +1,205 @@
+#include "./tree_traversal.h"
+#include <nan.h>
+#include <tree_sitter/api.h>
+#include <v8.h>
+#include "./addon_data.h"
+#include "./node.h"
+#include "./util.h"
+
+namespace node_tree_sitter {
+
+using namespace v8;
+
+// Each event is four values: the event kind, the node's id within the
+// traversal, the node's type id and its depth below the traversal's root.
+// The enter and exit events of a node share its id.
+static const uint32_t EVENT_SIZE = 4;
+static const uint32_t ENTER_EVENT = 0;
+static const uint32_t EXIT_EVENT = 1;
+static const uint32_t NOT_ENTERED = UINT32_MAX;
+static const uint32_t DEFAULT_CHUNK_SIZE = 1024;
+
+void TreeTraversal::Init(v8::Local<v8::Object> exports) {
+  Local<FunctionTemplate> tpl = Nan::New<FunctionTemplate>(New);
+  Local<String> class_name = Nan::New("TreeTraversal").ToLocalChecked();
+  tpl->SetClassName(class_name);
+  tpl->InstanceTemplate()->SetInternalFieldCount(1);
+
+  FunctionPair methods[] = {
+    {"next", Next},
+    {"_nodeAt", NodeAt},
+  };
+
+  for (size_t i = 0; i < length_of_array(methods); i++) {
+    Nan::SetPrototypeMethod(tpl, methods[i].name, methods[i].callback);
+  }
+
+  Local<Function> constructor_local = Nan::GetFunction(tpl).ToLocalChecked();
+  Nan::Set(constructor_local, Nan::New("EVENT_SIZE").ToLocalChecked(), Nan::New(EVENT_SIZE));
+  Nan::Set(constructor_local, Nan::New("ENTER").ToLocalChecked(), Nan::New(ENTER_EVENT));
+  Nan::Set(constructor_local, Nan::New("EXIT").ToLocalChecked(), Nan::New(EXIT_EVENT));
+  AddonData *data = AddonData::Get();
+  AddonData::SetOnce(data->tree_traversal_constructor, constructor_local);
+  Nan::Set(exports, class_name, Nan::New(data->tree_traversal_constructor));
+}
+
+Local<Value> TreeTraversal::NewInstance(Tree *tree, TSNode node, const TraversalFilter &filter) {
+  Local<Object> self;
+  MaybeLocal<Object> maybe_self = Nan::New(AddonData::Get()->tree_traversal_constructor)->NewInstance(Nan::GetCurrentContext());
+  if (maybe_self.ToLocal(&self)) {
+    (new TreeTraversal(tree, node, filter))->Wrap(self);
+    return self;
+  } else {
+    return Nan::Null();
+  }
+}
+
+TreeTraversal::TreeTraversal(Tree *tree, TSNode node, const TraversalFilter &filter) :
+  cursor_(ts_tree_cursor_new(node)),
+  filter_(filter),
+  edit_count_(tree->edit_count_),
+  depth_(0),
+  visited_children_(false),
+  done_(false),
+  next_id_(0) {}
+
+TreeTraversal::~TreeTraversal() { ts_tree_cursor_delete(&cursor_); }
+
+void TreeTraversal::New(const Nan::FunctionCallbackInfo<Value> &info) {
+  info.GetReturnValue().Set(Nan::Null());
+}
+
+bool TreeTraversal::Matches(TSNode node) const {
+  if (filter_.named_only && !ts_node_is_named(node)) return false;
+  return filter_.types.empty() || filter_.types[ts_node_symbol(node)];
+}
+
+void TreeTraversal::Emit(uint32_t kind, uint32_t id, TSNode node) {
+  events_.push_back(kind);
+  events_.push_back(id);
+  events_.push_back(ts_node_symbol(node));
+  events_.push_back(depth_);
+  event_nodes_.push_back(node);
+}
+
+static Tree *UnwrapTraversalTree(const Nan::FunctionCallbackInfo<Value> &info, uint32_t edit_count) {
+  Local<String> key = Nan::New<String>("tree").ToLocalChecked();
+  Tree *tree = Tree::UnwrapTree(Nan::Get(info.This(), key).ToLocalChecked());
+  if (!tree) {
+    Nan::ThrowTypeError("The traversal has no tree");
+    return nullptr;
+  }
+
+  // Editing a tree replaces some of its subtrees, which would leave the
+  // cursor pointing at stale ones.
+  if (tree->edit_count_ != edit_count) {
+    Nan::ThrowError("The tree was edited during the traversal");
+    return nullptr;
+  }
+  return tree;
+}
+
+void TreeTraversal::Next(const Nan::FunctionCallbackInfo<Value> &info) {
+  TreeTraversal *traversal = Nan::ObjectWrap::Unwrap<TreeTraversal>(info.This());
+  if (!UnwrapTraversalTree(info, traversal->edit_count_)) return;
+
+  uint32_t chunk_size = DEFAULT_CHUNK_SIZE;
+  if (info.Length() > 0 && !info[0]->IsUndefined()) {
+    chunk_size = Nan::To<uint32_t>(info[0]).FromMaybe(0);
+    if (chunk_size == 0) {
+      Nan::ThrowTypeError("Chunk size must be a positive integer");
+      return;
+    }
+  }
+
+  const TraversalFilter &filter = traversal->filter_;
+  TSTreeCursor *cursor = &traversal->cursor_;
+  std::vector<uint32_t> &events = traversal->events_;
+  events.clear();
+  traversal->event_nodes_.clear();
+
+  size_t event_limit = static_cast<size_t>(chunk_size) * EVENT_SIZE;
+  while (!traversal->done_ && events.size() < event_limit) {
+    TSNode node = ts_tree_cursor_current_node(cursor);
+
+    if (!traversal->visited_children_) {
+      bool is_before_range = filter.start_byte > 0 && ts_node_end_byte(node) <= filter.start_byte;
+      bool is_after_range = ts_node_start_byte(node) >= filter.end_byte;
+
+      if (is_before_range || is_after_range) {
+        // A node before the range is skipped in favor of its next sibling.
+        // A node after the range ends its level, since the following
+        // siblings start even later.
+        if (is_before_range && ts_tree_cursor_goto_next_sibling(cursor)) continue;
+        if (traversal->depth_ == 0) {
+          traversal->done_ = true;
+        } else {
+          ts_tree_cursor_goto_parent(cursor);
+          traversal->depth_--;
+          traversal->visited_children_ = true;
+        }
+        continue;
+      }
+
+      uint32_t id = NOT_ENTERED;
+      if (traversal->Matches(node)) {
+        id = traversal->next_id_++;
+        traversal->Emit(ENTER_EVENT, id, node);
+      }
+      traversal->entered_nodes_.push_back({id, node});
+
+      if (traversal->depth_ < filter.max_depth && ts_tree_cursor_goto_first_child(cursor)) {
+        traversal->depth_++;
+      } else {
+        traversal->visited_children_ = true;
+      }
+    } else {
+      EnteredNode entered = traversal->entered_nodes_.back();
+      traversal->entered_nodes_.pop_back();
+      if (entered.id != NOT_ENTERED) {
+        traversal->Emit(EXIT_EVENT, entered.id, entered.node);
+      }
+
+      if (traversal->depth_ == 0) {
+        traversal->done_ = true;
+      } else if (ts_tree_cursor_goto_next_sibling(cursor)) {
+        traversal->visited_children_ = false;
+      } else {
+        ts_tree_cursor_goto_parent(cursor);
+        traversal->depth_--;
+      }
+    }
+  }
+
+  if (events.empty()) {
+    info.GetReturnValue().Set(Nan::Null());
+    return;
+  }
+
+  Local<Object> buffer = Nan::CopyBuffer(
+    reinterpret_cast<const char *>(events.data()),
+    events.size() * sizeof(uint32_t)
+  ).ToLocalChecked();
+  Local<Uint8Array> bytes = buffer.As<Uint8Array>();
+  info.GetReturnValue().Set(Uint32Array::New(bytes->Buffer(), bytes->ByteOffset(), events.size()));
+}
+
+// Returns the node of an event in the latest chunk, given the event's index
+// in the chunk and its node id.
+void TreeTraversal::NodeAt(const Nan::FunctionCallbackInfo<Value> &info) {
+  TreeTraversal *traversal = Nan::ObjectWrap::Unwrap<TreeTraversal>(info.This());
+  Tree *tree = UnwrapTraversalTree(info, traversal->edit_count_);
+  if (!tree) return;
+
+  uint32_t index = Nan::To<uint32_t>(info[0]).FromMaybe(UINT32_MAX);
+  uint32_t id = Nan::To<uint32_t>(info[1]).FromMaybe(NOT_ENTERED);
+  if (index >= traversal->event_nodes_.size() ||
+      traversal->events_[index * EVENT_SIZE + 1] != id) {
+    Nan::ThrowRangeError("The event is not in the traversal's latest chunk");
+    return;
+  }
+
+  info.GetReturnValue().Set(node_methods::GetMarshalNode(info, tree, traversal->event_nodes_[index]));
+}
+
+}  // namespace node_tree_sitter
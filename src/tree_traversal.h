@@ -0,0 +1,65 @@
+#ifndef NODE_TREE_SITTER_TREE_TRAVERSAL_H_
+#define NODE_TREE_SITTER_TREE_TRAVERSAL_H_
+
+#include <v8.h>
+#include <nan.h>
+#include <node_object_wrap.h>
+#include <vector>
+#include <tree_sitter/api.h>
+#include "./tree.h"
+
+namespace node_tree_sitter {
+
+// The options for a traversal. An empty `types` mask matches every type.
+struct TraversalFilter {
+  std::vector<bool> types;
+  bool named_only;
+  uint32_t max_depth;
+  uint32_t start_byte;
+  uint32_t end_byte;
+};
+
+// A preorder walk over a node's descendants that produces enter and exit
+// events in chunks, so that a huge tree can be traversed without holding
+// all of its events at once.
+class TreeTraversal : public Nan::ObjectWrap {
+ public:
+  static void Init(v8::Local<v8::Object> exports);
+  static v8::Local<v8::Value> NewInstance(Tree *, TSNode, const TraversalFilter &);
+
+ private:
+  explicit TreeTraversal(Tree *, TSNode, const TraversalFilter &);
+  ~TreeTraversal();
+
+  static void New(const Nan::FunctionCallbackInfo<v8::Value> &);
+  static void Next(const Nan::FunctionCallbackInfo<v8::Value> &);
+  static void NodeAt(const Nan::FunctionCallbackInfo<v8::Value> &);
+
+  bool Matches(TSNode) const;
+  void Emit(uint32_t kind, uint32_t id, TSNode);
+
+  TSTreeCursor cursor_;
+  TraversalFilter filter_;
+  uint32_t edit_count_;
+  uint32_t depth_;
+  bool visited_children_;
+  bool done_;
+  uint32_t next_id_;
+
+  // For each level of the cursor, the node and its id if an enter event was
+  // emitted for it, so that the matching exit event can be emitted later.
+  struct EnteredNode {
+    uint32_t id;
+    TSNode node;
+  };
+  std::vector<EnteredNode> entered_nodes_;
+
+  // The events of the latest chunk, and the node of each event, so that a
+  // node only gets a slot in the tree's node table when it is asked for.
+  std::vector<uint32_t> events_;
+  std::vector<TSNode> event_nodes_;
+};
+
+}  // namespace node_tree_sitter
+
+#endif  // NODE_TREE_SITTER_TREE_TRAVERSAL_H_
@@ -62,6 +62,19 @@ describe("Node", () => {
         ["identifier", "+", "number"]
       );
     });
+
+    it("returns the same objects as other ways of reaching the same nodes", () => {
+      const tree = parser.parse("x10 + 1000");
+      const sumNode = tree.rootNode.firstChild.firstChild;
+      const [left, , right] = sumNode.children;
+      assert.strictEqual(sumNode.firstChild, left);
+      assert.strictEqual(sumNode.children[2], right);
+      assert.deepEqual(
+        sumNode.descendantsOfType(["identifier", "number"]),
+        [left, right]
+      );
+      assert.strictEqual(sumNode.descendantsOfType("number")[0], right);
+    });
   });
 
   describe(".namedChildren", () => {
@@ -94,6 +107,32 @@ describe("Node", () => {
     });
   });
 
+  describe("scalar getters in a hot loop", () => {
+    it("return the same values once the getters are optimized", () => {
+      const tree = parser.parse("a👍 + b * * c");
+      const sum = tree.rootNode.firstChild.firstChild;
+      const nodes = [sum, ...sum.children];
+      const expected = nodes.map(node => [
+        node.startIndex, node.endIndex, node.typeId, node.childCount, node.isNamed, node.hasError()
+      ]);
+
+      for (let i = 0; i < 100000; i++) {
+        const node = nodes[i % nodes.length];
+        const values = expected[i % nodes.length];
+        if (
+          node.startIndex !== values[0] ||
+          node.endIndex !== values[1] ||
+          node.typeId !== values[2] ||
+          node.childCount !== values[3] ||
+          node.isNamed !== values[4] ||
+          node.hasError() !== values[5]
+        ) {
+          assert.fail(`Wrong values for ${node.type} at iteration ${i}`);
+        }
+      }
+    });
+  });
+
   describe(".startPosition and .endPosition", () => {
     it("returns the row and column where the node starts/ends in the text", () => {
       const tree = parser.parse("x10 + 1000");
@@ -332,6 +371,138 @@ describe("Node", () => {
     });
   });
 
+  describe('.traverse(options)', () => {
+    const {ENTER, EXIT, EVENT_SIZE} = Parser.TreeTraversal;
+
+    function collectEvents(traversal, chunkSize) {
+      const result = [];
+      for (let events; (events = traversal.next(chunkSize)) !== null;) {
+        assert.isAtMost(events.length, chunkSize * EVENT_SIZE);
+        for (let i = 0; i < events.length; i += EVENT_SIZE) {
+          const node = traversal.nodeAt(events, i);
+          result.push([events[i] === ENTER ? 'enter' : 'exit', node.type, events[i + 3]]);
+        }
+      }
+      return result;
+    }
+
+    it('emits nested enter and exit events for nodes of the given types', () => {
+      const tree = parser.parse("f(a + g(b), c)");
+      const traversal = tree.rootNode.traverse({types: ['call_expression', 'identifier']});
+      assert.deepEqual(collectEvents(traversal, 1024), [
+        ['enter', 'call_expression', 2],
+        ['enter', 'identifier', 3],
+        ['exit', 'identifier', 3],
+        ['enter', 'identifier', 5],
+        ['exit', 'identifier', 5],
+        ['enter', 'call_expression', 5],
+        ['enter', 'identifier', 6],
+        ['exit', 'identifier', 6],
+        ['enter', 'identifier', 7],
+        ['exit', 'identifier', 7],
+        ['exit', 'call_expression', 5],
+        ['enter', 'identifier', 4],
+        ['exit', 'identifier', 4],
+        ['exit', 'call_expression', 2],
+      ]);
+    });
+
+    it('can be resumed in chunks', () => {
+      const tree = parser.parse("f(a + g(b), c)");
+      const whole = collectEvents(tree.rootNode.traverse({namedOnly: true}), 1024);
+      const chunked = collectEvents(tree.rootNode.traverse({namedOnly: true}), 3);
+      assert.deepEqual(chunked, whole);
+      assert.equal(whole.filter(([kind]) => kind === 'enter').length, 12);
+    });
+
+    it('returns the same node objects as the rest of the API', () => {
+      const tree = parser.parse("f(a, b)");
+      const traversal = tree.rootNode.traverse({types: 'arguments'});
+      const events = traversal.next();
+      assert.equal(traversal.nodeAt(events, 0), tree.rootNode.firstChild.firstChild.lastChild);
+    });
+
+    it('respects maxDepth and the index range', () => {
+      const tree = parser.parse("a; b; c;");
+      const shallow = collectEvents(tree.rootNode.traverse({namedOnly: true, maxDepth: 1}), 1024);
+      assert.deepEqual(shallow.filter(([kind]) => kind === 'enter').map(([, type]) => type), [
+        'program', 'expression_statement', 'expression_statement', 'expression_statement'
+      ]);
+
+      const ranged = collectEvents(tree.rootNode.traverse({types: 'identifier', startIndex: 3, endIndex: 4}), 1024);
+      assert.deepEqual(ranged, [['enter', 'identifier', 2], ['exit', 'identifier', 2]]);
+    });
+
+    it('only returns nodes for events of the latest chunk', () => {
+      const tree = parser.parse("a; b;");
+      const traversal = tree.rootNode.traverse({types: 'identifier'});
+      const first = traversal.next(1);
+      assert.equal(traversal.nodeAt(first, 0).text, 'a');
+      traversal.next(1);
+      const third = traversal.next(1);
+      assert.equal(traversal.nodeAt(third, 0).text, 'b');
+      assert.throws(() => traversal.nodeAt(first, 0), /latest chunk/);
+    });
+
+    it('rejects a maxDepth that is not a non-negative integer', () => {
+      const tree = parser.parse("a;");
+      for (const maxDepth of ['deep', -1, 1.5, NaN]) {
+        assert.throws(() => tree.rootNode.traverse({maxDepth}), /maxDepth must be an integer/);
+      }
+    });
+
+    it('throws if the tree is edited during the traversal', () => {
+      const tree = parser.parse("a; b;");
+      const traversal = tree.rootNode.traverse();
+      traversal.next(1);
+      tree.edit({
+        startIndex: 0, oldEndIndex: 0, newEndIndex: 1,
+        startPosition: {row: 0, column: 0},
+        oldEndPosition: {row: 0, column: 0},
+        newEndPosition: {row: 0, column: 1},
+      });
+      assert.throws(() => traversal.next(), /edited during the traversal/);
+    });
+  });
+
+  describe('.read(mask) and SyntaxNode.readMany(nodes, mask)', () => {
+    const {TYPE_ID, START_INDEX, START_POSITION, END_POSITION, CHILD_COUNT, FLAGS} = Parser.SyntaxNode.ReadFields;
+
+    it('reads the selected properties of a node', () => {
+      const tree = parser.parse("x = [1,\n  2];");
+      const array = tree.rootNode.descendantsOfType('array')[0];
+      const mask = TYPE_ID | START_POSITION | END_POSITION | CHILD_COUNT | FLAGS;
+      assert.equal(Parser.SyntaxNode.readSize(mask), 7);
+      assert.deepEqual(Array.from(array.read(mask)), [
+        array.typeId,
+        0, 4,
+        1, 4,
+        array.childCount,
+        Parser.Tree.FlatNodeFlags.NAMED,
+      ]);
+    });
+
+    it('reads many nodes into one array', () => {
+      const tree = parser.parse("a + b * c");
+      const identifiers = tree.rootNode.descendantsOfType('identifier');
+      const out = Parser.SyntaxNode.readMany(identifiers, START_INDEX | START_POSITION);
+      assert.deepEqual(Array.from(out), [
+        0, 0, 0,
+        4, 0, 4,
+        8, 0, 8,
+      ]);
+    });
+
+    it('throws when the output array is too small', () => {
+      const tree = parser.parse("a + b");
+      const identifiers = tree.rootNode.descendantsOfType('identifier');
+      assert.throws(
+        () => Parser.SyntaxNode.readMany(identifiers, START_POSITION, new Uint32Array(3)),
+        /output array is too small/
+      );
+    });
+  });
+
   describe(".firstChildForIndex(index)", () => {
     it("returns the first child that extends beyond the given index", () => {
       const tree = parser.parse("x10 + 1000");
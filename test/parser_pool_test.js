@@ -0,0 +1,82 @@
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+const Parser = require("..");
+const JavaScript = require('tree-sitter-javascript');
+const { assert } = require("chai");
+const { ParserPool } = Parser;
+
+describe("ParserPool", () => {
+  let pool;
+
+  beforeEach(() => {
+    pool = new ParserPool(2).setLanguage(JavaScript);
+  });
+
+  describe(".parseMany", () => {
+    it("parses buffers and files on several threads", async () => {
+      const filePath = path.join(os.tmpdir(), `parser-pool-test-${process.pid}.js`);
+      fs.writeFileSync(filePath, "let ĉ = 1;");
+
+      const sources = ["a + b", "[" + "0,".repeat(1000) + "]", "x * y"];
+      const inputs = sources.map(source => Buffer.from(source)).concat([filePath]);
+      const completed = [];
+      try {
+        const trees = await pool.parseMany(inputs, {
+          encoding: 'utf8',
+          onTree: (tree, index) => completed.push(index)
+        });
+
+        assert.deepEqual(completed.sort(), [0, 1, 2, 3]);
+        assert.equal(trees.length, 4);
+        assert.equal(trees[0].rootNode.firstChild.firstChild.type, "binary_expression");
+        assert.equal(trees[1].rootNode.firstChild.firstChild.namedChildCount, 1000);
+        assert.equal(trees[3].encoding, "utf8");
+        assert.equal(trees[3].rootNode.descendantsOfType("identifier")[0].text, "ĉ");
+      } finally {
+        fs.unlinkSync(filePath);
+      }
+    });
+
+    it("reads UTF-16 by default, like Parser", async () => {
+      const [tree] = await pool.parseMany([Buffer.from("a + ĉ", "utf16le")]);
+      assert.equal(tree.encoding, "utf16");
+      assert.equal(tree.rootNode.firstChild.firstChild.lastChild.text, "ĉ");
+      assert.equal(tree.rootNode.endIndex, 5);
+    });
+
+    it("can parse several batches with the same threads", async () => {
+      for (let i = 0; i < 3; i++) {
+        const inputs = ["a", "b + c", "d(e)"].map(source => Buffer.from(source + i, "utf8"));
+        const trees = await pool.parseMany(inputs, {encoding: 'utf8'});
+        assert.deepEqual(trees.map(tree => tree.rootNode.firstChild.text), ["a", "b + c", "d(e)"].map(source => source + i));
+      }
+    });
+
+    it("rejects when a file cannot be read", async () => {
+      let error;
+      try {
+        await pool.parseMany([Buffer.from("a"), path.join(os.tmpdir(), "does-not-exist.js")]);
+      } catch (e) {
+        error = e;
+      }
+      assert.match(error.message, /Could not read file/);
+    });
+
+    it("rejects when a path is a directory", async () => {
+      let error;
+      try {
+        await pool.parseMany([os.tmpdir()]);
+      } catch (e) {
+        error = e;
+      }
+      assert.match(error.message, /Could not read file/);
+    });
+
+    it("does not allow the pool to be reconfigured while parsing", async () => {
+      const promise = pool.parseMany([Buffer.from("a + b")]);
+      assert.throws(() => pool.setLanguage(JavaScript), /Parser pool is in use/);
+      await promise;
+    });
+  });
+});
@@ -2,6 +2,9 @@ const Parser = require("..");
 const JavaScript = require('tree-sitter-javascript');
 const { assert } = require("chai");
 const {TextBuffer} = require('superstring');
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
 
 describe("Parser", () => {
   let parser;
@@ -125,6 +128,47 @@ describe("Parser", () => {
       });
     });
 
+    it("reads strings with one-byte and two-byte contents", () => {
+      const latin1 = parser.parse("café + 1");
+      assert.equal(latin1.rootNode.toString(), "(program (expression_statement (binary_expression left: (identifier) right: (number))))");
+      assert.equal(latin1.rootNode.firstChild.firstChild.lastChild.startIndex, 7);
+
+      const emoji = parser.parse("'👍' + 1");
+      assert.equal(emoji.rootNode.firstChild.firstChild.lastChild.startIndex, 7);
+
+      parser.setEncoding("utf8");
+      const utf8 = parser.parse("café + 1");
+      assert.equal(utf8.rootNode.firstChild.firstChild.lastChild.startIndex, 8);
+      assert.equal(utf8.rootNode.firstChild.firstChild.firstChild.text, "café");
+    });
+
+    describe("when the input is a buffer", () => {
+      it("reads the text from the buffer in the given encoding", () => {
+        const source = Buffer.from("const ĉ = 1;", "utf8");
+        const tree = parser.parse(source, null, {encoding: "utf8"});
+        assert.equal(tree.encoding, "utf8");
+        assert.equal(
+          tree.rootNode.toString(),
+          "(program (lexical_declaration (variable_declarator name: (identifier) value: (number))))"
+        );
+        assert.equal(tree.rootNode.endIndex, source.length);
+        assert.equal(tree.rootNode.descendantsOfType("identifier")[0].text, "ĉ");
+      });
+
+      it("reads typed arrays and array buffers", () => {
+        const utf16 = Buffer.from("a + ĉ", "utf16le");
+        const view = new Uint16Array(utf16.buffer, utf16.byteOffset, utf16.length / 2);
+        const tree = parser.parse(view);
+        assert.equal(tree.encoding, "utf16");
+        assert.equal(tree.rootNode.descendantsOfType("identifier")[1].text, "ĉ");
+
+        const utf8 = new TextEncoder().encode("b * c");
+        const arrayBufferTree = parser.parse(utf8.buffer, null, {encoding: "utf8"});
+        assert.equal(arrayBufferTree.rootNode.endIndex, 5);
+        assert.equal(arrayBufferTree.rootNode.firstChild.firstChild.lastChild.text, "c");
+      });
+    });
+
     it("handles long input strings", () => {
       const repeatCount = 10000;
       const inputString = "[" + "0,".repeat(repeatCount) + "]";
@@ -134,6 +178,43 @@ describe("Parser", () => {
       assert.equal(tree.rootNode.firstChild.firstChild.namedChildCount, repeatCount);
     });
 
+    describe("when the encoding is set to utf8", () => {
+      beforeEach(() => {
+        parser.setEncoding("utf8");
+      });
+
+      it("measures indices and columns in bytes", () => {
+        const tree = parser.parse("'ĉĉ' + a");
+        const identifier = tree.rootNode.descendantsOfType("identifier")[0];
+        assert.equal(tree.encoding, "utf8");
+        assert.equal(identifier.startIndex, 9);
+        assert.deepEqual(identifier.startPosition, {row: 0, column: 9});
+        assert.equal(identifier.text, "a");
+        assert.equal(tree.rootNode.firstChild.firstChild.firstChild.text, "'ĉĉ'");
+      });
+
+      it("reads buffers returned by the input callback", () => {
+        const source = Buffer.from("const ĉ = 1;", "utf8");
+        const tree = parser.parse((index) => source.subarray(index));
+        assert.equal(
+          tree.rootNode.toString(),
+          "(program (lexical_declaration (variable_declarator name: (identifier) value: (number))))"
+        );
+        assert.equal(tree.rootNode.endIndex, source.length);
+      });
+
+      it("rejects old trees that were parsed as utf16", () => {
+        parser.setEncoding("utf16");
+        const tree = parser.parse("a");
+        parser.setEncoding("utf8");
+        assert.throws(() => parser.parse("a", tree), /different encoding/);
+      });
+
+      it("throws on unknown encodings", () => {
+        assert.throws(() => parser.setEncoding("latin1"), /Encoding must be/);
+      });
+    });
+
     describe('when the `includedRanges` option is given', () => {
       it('parses the text within those ranges of the string', () => {
         const sourceCode = "<% foo() %> <% bar %>";
@@ -168,6 +249,172 @@ describe("Parser", () => {
     })
   });
 
+  describe(".parse with a time slice", () => {
+    beforeEach(() => {
+      parser.setLanguage(JavaScript);
+    });
+
+    it("returns the tree if the parse finishes within the first slice", () => {
+      const tree = parser.parse("a + b", null, {timeSliceMicros: 1000000});
+      assert.equal(tree.rootNode.toString(), "(program (expression_statement (binary_expression left: (identifier) right: (identifier))))");
+    });
+
+    it("resumes the parse on later turns of the event loop", async () => {
+      const sourceCode = "[" + "0,".repeat(200000) + "]";
+      const result = parser.parse(sourceCode, null, {timeSliceMicros: 100});
+      assert.instanceOf(result, Promise);
+      assert.throws(() => parser.parse("a"), /Parser is in use/);
+
+      const tree = await result;
+      assert.equal(tree.rootNode.firstChild.firstChild.namedChildCount, 200000);
+      assert.equal(tree.rootNode.firstChild.firstChild.firstNamedChild.text, "0");
+      assert.ok(parser.parse("a"));
+    });
+
+    it("stops between slices when the signal is aborted", async () => {
+      const sourceCode = "[" + "0,".repeat(200000) + "]";
+      const controller = new AbortController();
+      const result = parser.parse(sourceCode, null, {timeSliceMicros: 100, signal: controller.signal});
+      controller.abort();
+
+      let error;
+      try {
+        await result;
+      } catch (e) {
+        error = e;
+      }
+      assert.equal(error.name, 'AbortError');
+      assert.equal(parser.parse("a").rootNode.toString(), "(program (expression_statement (identifier)))");
+    });
+  });
+
+  describe('.parseAsync', () => {
+    beforeEach(() => {
+      parser.setLanguage(JavaScript);
+    });
+
+    it('parses strings and buffers on a background thread', async () => {
+      const sourceCode = "[" + "0,".repeat(40) + "]";
+      const tree = await parser.parseAsync(sourceCode);
+      const arrayNode = tree.rootNode.firstChild.firstChild;
+      assert.equal(arrayNode.type, "array");
+      assert.equal(arrayNode.namedChildCount, 40);
+      assert.equal(arrayNode.firstNamedChild.text, "0");
+
+      const bufferTree = await parser.parseAsync(Buffer.from("const ĉ = 1;"), null, {encoding: "utf8"});
+      assert.equal(bufferTree.encoding, "utf8");
+      assert.equal(bufferTree.rootNode.descendantsOfType("identifier")[0].text, "ĉ");
+    });
+
+    it('reuses the old tree', async () => {
+      const tree = await parser.parseAsync("a + b");
+      tree.edit({
+        startIndex: 5,
+        oldEndIndex: 5,
+        newEndIndex: 9,
+        startPosition: {row: 0, column: 5},
+        oldEndPosition: {row: 0, column: 5},
+        newEndPosition: {row: 0, column: 9}
+      });
+      const newTree = await parser.parseAsync("a + b + c", tree);
+      assert.equal(
+        newTree.rootNode.toString(),
+        "(program (expression_statement (binary_expression left: (binary_expression left: (identifier) right: (identifier)) right: (identifier))))"
+      );
+      assert.deepEqual(tree.getChangedRanges(newTree).map(range => range.endIndex), [9]);
+    });
+
+    it('does not allow the parser to be mutated while parsing', async () => {
+      const treePromise = parser.parseAsync('a + b + c');
+
+      assert.throws(() => {
+        parser.parse('first-word');
+      }, /Parser is in use/);
+
+      await treePromise;
+      assert.ok(parser.parse('first-word'));
+    });
+
+    it('stops parsing when the signal is aborted', async () => {
+      const sourceCode = "[" + "0,".repeat(500000) + "]";
+      const controller = new AbortController();
+      const treePromise = parser.parseAsync(sourceCode, null, {signal: controller.signal});
+      controller.abort();
+
+      let error;
+      try {
+        await treePromise;
+      } catch (e) {
+        error = e;
+      }
+      assert.equal(error.name, 'AbortError');
+
+      const tree = await parser.parseAsync("a + b");
+      assert.equal(tree.rootNode.toString(), "(program (expression_statement (binary_expression left: (identifier) right: (identifier))))");
+    });
+
+    it('rejects straight away when the signal was already aborted', async () => {
+      const controller = new AbortController();
+      controller.abort();
+
+      let error;
+      try {
+        await parser.parseAsync("a + b", null, {signal: controller.signal});
+      } catch (e) {
+        error = e;
+      }
+      assert.equal(error.name, 'AbortError');
+      assert.ok(parser.parse("a"));
+    });
+
+    it('rejects inputs that would need to call back into JavaScript', async () => {
+      let error;
+      try {
+        await parser.parseAsync(() => null);
+      } catch (e) {
+        error = e;
+      }
+      assert.match(error.message, /Input must be a string or a buffer/);
+    });
+  });
+
+  describe('.parseFile', () => {
+    const filePath = path.join(os.tmpdir(), `parse-file-test-${process.pid}.js`);
+
+    beforeEach(() => {
+      parser.setLanguage(JavaScript);
+      fs.writeFileSync(filePath, "const ĉ = 'x';\n");
+    });
+
+    afterEach(() => {
+      fs.unlinkSync(filePath);
+    });
+
+    it('parses the mapped file, and reads node text from the mapping', async () => {
+      const tree = parser.parseFile(filePath, {encoding: 'utf8'});
+      assert.equal(tree.encoding, 'utf8');
+      assert.equal(tree.rootNode.endIndex, Buffer.byteLength("const ĉ = 'x';\n"));
+      assert.equal(tree.rootNode.descendantsOfType('identifier')[0].text, 'ĉ');
+      assert.equal(tree.rootNode.descendantsOfType('string')[0].text, "'x'");
+
+      const asyncTree = await parser.parseFile(filePath, {encoding: 'utf8', async: true});
+      assert.equal(asyncTree.rootNode.toString(), tree.rootNode.toString());
+    });
+
+    it('reports files that cannot be read', async () => {
+      const missingPath = filePath + '.missing';
+      assert.throws(() => parser.parseFile(missingPath), /Could not read file/);
+
+      let error;
+      try {
+        await parser.parseFile(missingPath, {async: true});
+      } catch (e) {
+        error = e;
+      }
+      assert.match(error.message, /Could not read file/);
+    });
+  });
+
   describe('.parseTextBuffer', () => {
     beforeEach(() => {
       parser.setLanguage(JavaScript);
@@ -203,6 +450,29 @@ describe("Parser", () => {
       assert.equal(newArrayNode.namedChildCount, elementCount + 1);
     });
 
+    it('reuses the old tree when reparsing on the background thread', async () => {
+      const buffer = new TextBuffer('f(a);\ng(b);\nh(c);');
+      const tree = await parser.parseTextBuffer(buffer);
+
+      buffer.setTextInRange({start: {row: 1, column: 2}, end: {row: 1, column: 3}}, 'bb, d');
+      tree.edit({
+        startIndex: 8,
+        oldEndIndex: 9,
+        newEndIndex: 13,
+        startPosition: {row: 1, column: 2},
+        oldEndPosition: {row: 1, column: 3},
+        newEndPosition: {row: 1, column: 7}
+      });
+
+      const newTree = await parser.parseTextBuffer(buffer, tree);
+      assert.equal(newTree.rootNode.child(1).text, 'g(bb, d);');
+      assert.equal(newTree.rootNode.child(2).text, 'h(c);');
+      for (const range of tree.getChangedRanges(newTree)) {
+        assert.isAtLeast(range.startIndex, 6);
+        assert.isAtMost(range.endIndex, 15);
+      }
+    });
+
     it('does not allow the parser to be mutated while parsing', async () => {
       const buffer = new TextBuffer('a + b + c');
       const treePromise = parser.parseTextBuffer(buffer);
@@ -298,10 +568,78 @@ describe("Parser", () => {
       );
     });
 
+    it('reparses buffers that are split into many slices', () => {
+      parser.setLanguage(JavaScript);
+      const buffer = new TextBuffer('x'.repeat(200).split('').join(' + '));
+      let tree = parser.parseTextBufferSync(buffer);
+
+      for (let i = 0; i < 100; i++) {
+        const column = i * 8;
+        buffer.setTextInRange({start: {row: 0, column}, end: {row: 0, column: column + 1}}, 'y');
+        tree.edit({
+          startIndex: column,
+          oldEndIndex: column + 1,
+          newEndIndex: column + 1,
+          startPosition: {row: 0, column},
+          oldEndPosition: {row: 0, column: column + 1},
+          newEndPosition: {row: 0, column: column + 1}
+        });
+        tree = parser.parseTextBufferSync(buffer, tree);
+      }
+
+      assert.equal(tree.rootNode.toString(), parser.parse(buffer.getText()).rootNode.toString());
+      assert.equal(tree.rootNode.descendantsOfType('identifier')[199].text, 'x');
+      assert.equal(tree.rootNode.descendantsOfType('identifier')[198].text, 'y');
+    });
+
     it('returns null if no language has been set', () => {
       const buffer = new TextBuffer('αβ αβδ')
       const tree = parser.parseTextBufferSync(buffer);
       assert.equal(tree, null);
     })
   });
+
+  describe('in worker threads', () => {
+    it('parses independently in each worker', async function() {
+      const {Worker} = require('worker_threads');
+
+      // Grammars built before context-aware addons can't be loaded in a
+      // worker, in which case there is nothing to parse with.
+      const source = `
+        const {parentPort, workerData} = require('worker_threads');
+        const Parser = require(workerData.parserPath);
+        let JavaScript;
+        try {
+          JavaScript = require(workerData.languagePath);
+        } catch (e) {
+          parentPort.postMessage(null);
+          return;
+        }
+        const parser = new Parser().setLanguage(JavaScript);
+        const tree = parser.parse(workerData.input);
+        parentPort.postMessage(tree.rootNode.descendantsOfType('identifier').map(node => node.text));
+      `;
+
+      const run = (input) => new Promise((resolve, reject) => {
+        const worker = new Worker(`(() => {${source}})()`, {
+          eval: true,
+          workerData: {
+            parserPath: path.join(__dirname, '..'),
+            languagePath: require.resolve('tree-sitter-javascript'),
+            input
+          }
+        });
+        worker.once('message', resolve);
+        worker.once('error', reject);
+      });
+
+      const results = await Promise.all([run('a + b'), run('c(d, e)'), run('f.g')]);
+      if (results.includes(null)) this.skip();
+      assert.deepEqual(results, [['a', 'b'], ['c', 'd', 'e'], ['f']]);
+
+      parser.setLanguage(JavaScript);
+      const tree = parser.parse('x + y');
+      assert.deepEqual(tree.rootNode.descendantsOfType('identifier').map(node => node.text), ['x', 'y']);
+    });
+  });
 });
@@ -76,6 +76,134 @@ describe("Query", () => {
     });
   });
 
+  describe(".iterMatches", () => {
+    it("yields the same matches as .matches, a chunk at a time", () => {
+      const tree = parser.parse("a(b); c(d); e(f); g(h);");
+      const query = new Query(JavaScript, `
+        ((call_expression function: (identifier) @fn) (#not-eq? @fn "c"))
+        (arguments (identifier) @arg)
+      `);
+
+      const expected = formatMatches(tree, query.matches(tree.rootNode));
+      const matches = [...query.iterMatches(tree.rootNode, {chunkSize: 2})];
+      assert.deepEqual(formatMatches(tree, matches), expected);
+    });
+
+    it("stops after the given number of matches", () => {
+      const tree = parser.parse("a(b); c(d); e(f); g(h);");
+      const query = new Query(JavaScript, "(identifier) @id");
+
+      const matches = [...query.iterMatches(tree.rootNode, {limit: 3})];
+      assert.deepEqual(formatMatches(tree, matches), [
+        { pattern: 0, captures: [{ name: "id", text: "a" }] },
+        { pattern: 0, captures: [{ name: "id", text: "b" }] },
+        { pattern: 0, captures: [{ name: "id", text: "c" }] },
+      ]);
+    });
+
+    it("throws if the tree is edited during the iteration", () => {
+      const tree = parser.parse("a(b); c(d);");
+      const query = new Query(JavaScript, "(identifier) @id");
+      const iterator = query.iterMatches(tree.rootNode, {chunkSize: 1});
+      iterator.next();
+      tree.edit({
+        startIndex: 0,
+        oldEndIndex: 0,
+        newEndIndex: 1,
+        startPosition: {row: 0, column: 0},
+        oldEndPosition: {row: 0, column: 0},
+        newEndPosition: {row: 0, column: 1},
+      });
+      assert.throws(() => iterator.next(), /edited/);
+    });
+  });
+
+  describe(".matchesAsync", () => {
+    it("resolves with the same matches as .matches, in compact form", async () => {
+      const source = "a(b); Cd(e, f); g();";
+      const query = new Query(JavaScript, `
+        (call_expression function: (identifier) @fn arguments: (arguments (identifier)* @arg))
+        ((identifier) @constructor (#match? @constructor "^[A-Z]") (#not-eq? @constructor "Ef"))
+      `);
+
+      for (const input of [source, (index) => source.slice(index)]) {
+        const tree = parser.parse(input);
+        const expected = query.matches(tree.rootNode).map(({pattern, captures}) => ({
+          pattern,
+          captures: captures.map(({name, node}) => [name, node.startIndex, node.endIndex]),
+        }));
+
+        const promise = query.matchesAsync(tree.rootNode);
+        tree.edit({
+          startIndex: 0,
+          oldEndIndex: 0,
+          newEndIndex: 1,
+          startPosition: {row: 0, column: 0},
+          oldEndPosition: {row: 0, column: 0},
+          newEndPosition: {row: 0, column: 1},
+        });
+        const {patterns, captureOffsets, captures} = await promise;
+
+        const matches = Array.from(patterns, (pattern, i) => {
+          const matchCaptures = [];
+          for (let row = captureOffsets[i]; row < captureOffsets[i + 1]; row++) {
+            const offset = row * Query.CAPTURE_SIZE;
+            matchCaptures.push([query.captureNames[captures[offset + 1]], captures[offset + 2], captures[offset + 3]]);
+          }
+          return {pattern, captures: matchCaptures};
+        });
+        assert.deepEqual(matches, expected);
+      }
+    });
+  });
+
+  describe(".didExceedMatchLimit", () => {
+    it("reports whether the last execution reached its match limit", () => {
+      const tree = parser.parse(`[${Array(64).fill("a").join(", ")}];`);
+      const query = new Query(JavaScript, "(array (identifier) @first (identifier) @second)");
+
+      query.matches(tree.rootNode, undefined, undefined, {matchLimit: 32});
+      assert.isTrue(query.didExceedMatchLimit());
+
+      query.matches(tree.rootNode);
+      assert.isFalse(query.didExceedMatchLimit());
+    });
+
+    it("reports the match limit of each iteration separately", () => {
+      const tree = parser.parse(`[${Array(64).fill("a").join(", ")}];`);
+      const query = new Query(JavaScript, "(array (identifier) @first (identifier) @second)");
+
+      const iterator = query.iterMatches(tree.rootNode, {matchLimit: 32});
+      [...iterator];
+      query.matches(tree.rootNode);
+      assert.isFalse(query.didExceedMatchLimit());
+      assert.isTrue(iterator.didExceedMatchLimit());
+    });
+
+    it("reports the match limit of an asynchronous execution with its result", async () => {
+      const tree = parser.parse(`[${Array(64).fill("a").join(", ")}];`);
+      const query = new Query(JavaScript, "(array (identifier) @first (identifier) @second)");
+
+      const limited = query.matchesAsync(tree.rootNode, undefined, undefined, {matchLimit: 32});
+      query.matches(tree.rootNode);
+      assert.isTrue((await limited).didExceedMatchLimit);
+      assert.isFalse(query.didExceedMatchLimit());
+      assert.isFalse((await query.matchesAsync(tree.rootNode)).didExceedMatchLimit);
+    });
+
+    it("allows queries to run while another execution is in progress", () => {
+      const tree = parser.parse("a(b); c(d);");
+      const query = new Query(JavaScript, "(identifier) @id");
+
+      const texts = [];
+      for (const match of query.iterMatches(tree.rootNode, {chunkSize: 1})) {
+        texts.push(match.captures[0].node.text);
+        assert.equal(query.matches(tree.rootNode).length, 4);
+      }
+      assert.deepEqual(texts, ["a", "b", "c", "d"]);
+    });
+  });
+
   describe(".captures", () => {
     it("returns all of the captures for the given query, in order", () => {
       const tree = parser.parse(`
@@ -171,6 +299,76 @@ describe("Query", () => {
       ]);
     });
 
+    it("checks text predicates the same way for every kind of input", () => {
+      const source = `const ü = require('./ü'); new Ünï(ÉF, ü);`;
+      const query = new Query(JavaScript, `
+        ((identifier) @function.builtin
+         (#eq? @function.builtin "require"))
+        ((identifier) @other
+         (#not-eq? @other "ü"))
+        ((identifier) @constructor
+         (#match? @constructor "^[A-ZÀ-Þ]"))
+      `);
+
+      const inputs = [
+        [source, {encoding: 'utf8'}],
+        [source, {encoding: 'utf16'}],
+        [Buffer.from(source, 'utf8'), {encoding: 'utf8'}],
+        [Buffer.from(source, 'utf16le'), {encoding: 'utf16'}],
+        [(index) => source.slice(index), {encoding: 'utf16'}],
+      ];
+
+      for (const [input, options] of inputs) {
+        const tree = parser.parse(input, null, options);
+        const captures = query.captures(tree.rootNode);
+        assert.deepEqual(formatCaptures(tree, captures), [
+          { name: "function.builtin", text: "require" },
+          { name: "other", text: "require" },
+          { name: "other", text: "Ünï" },
+          { name: "constructor", text: "Ünï" },
+          { name: "other", text: "ÉF" },
+          { name: "constructor", text: "ÉF" },
+        ]);
+      }
+    });
+
+    it("only copies the source text for queries with text predicates", () => {
+      const tree = parser.parse(`a(b);`);
+      new Query(JavaScript, `(identifier) @name`).captures(tree.rootNode);
+      assert.isUndefined(tree.inputBuffer);
+
+      const captures = new Query(JavaScript, `((identifier) @name (#eq? @name "b"))`).captures(tree.rootNode);
+      assert.deepEqual(formatCaptures(tree, captures), [{ name: "name", text: "b" }]);
+      assert.instanceOf(tree.inputBuffer, Buffer);
+    });
+
+    it("can return the captures as a flat array of ranges", () => {
+      const source = "const ab = require('./ab');\nnew Cd(EF);";
+      const query = new Query(JavaScript, `
+        (identifier) @variable
+        ((identifier) @constructor
+         (#match? @constructor "^[A-Z]"))
+      `);
+      assert.deepEqual(query.captureNames, ["variable", "constructor"]);
+
+      for (const input of [source, (index) => source.slice(index)]) {
+        const tree = parser.parse(input);
+        const expected = query.captures(tree.rootNode).map(({name, node}) => [
+          name, node.startIndex, node.endIndex,
+          node.startPosition.row, node.startPosition.column,
+          node.endPosition.row, node.endPosition.column,
+        ]);
+
+        const values = query.capturesCompact(tree.rootNode);
+        assert.instanceOf(values, Uint32Array);
+        const captures = [];
+        for (let i = 0; i < values.length; i += Query.CAPTURE_SIZE) {
+          captures.push([query.captureNames[values[i + 1]], ...values.slice(i + 2, i + Query.CAPTURE_SIZE)]);
+        }
+        assert.deepEqual(captures, expected);
+      }
+    });
+
     it("handles patterns with properties", () => {
       const tree = parser.parse(`a(b.c);`);
       const query = new Query(JavaScript, `
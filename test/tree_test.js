@@ -46,6 +46,19 @@ describe("Tree", () => {
       );
     });
 
+    it('updates nodes that were returned in batches, and keeps their identity', () => {
+      input = 'a; b; c;';
+      tree = parser.parse(input);
+      const statements = tree.rootNode.children;
+      assert.strictEqual(tree.rootNode.child(1), statements[1]);
+      assert.strictEqual(tree.rootNode.firstChild.firstChild.parent, statements[0]);
+
+      ([input, edit] = spliceInput(input, 0, 0, 'xyz\n'));
+      tree.edit(edit);
+      assert.deepEqual(statements.map(node => node.startIndex), [4, 7, 10]);
+      assert.deepEqual(statements[2].startPosition, {row: 1, column: 6});
+    });
+
     it("handles non-ascii characters", () => {
       input = 'αβδ + cde';
 
@@ -69,6 +82,72 @@ describe("Tree", () => {
         "(program (expression_statement (binary_expression left: (binary_expression left: (identifier) right: (identifier)) right: (identifier))))"
       );
     });
+
+    it("measures edits in bytes when the tree is utf8", () => {
+      parser.setEncoding('utf8');
+      tree = parser.parse('αβδ + cde');
+      const variableNode = tree.rootNode.firstChild.firstChild.lastChild;
+      assert.equal(variableNode.startIndex, 9);
+
+      tree.edit({
+        startIndex: 4,
+        oldEndIndex: 4,
+        newEndIndex: 11,
+        startPosition: {row: 0, column: 4},
+        oldEndPosition: {row: 0, column: 4},
+        newEndPosition: {row: 0, column: 11},
+      });
+      assert.equal(variableNode.startIndex, 16);
+      assert.deepEqual(variableNode.startPosition, {row: 0, column: 16});
+
+      tree = parser.parse('αβ👍 * δ + cde', tree);
+      assert.equal(
+        tree.rootNode.toString(),
+        "(program (expression_statement (binary_expression left: (binary_expression left: (identifier) right: (identifier)) right: (identifier))))"
+      );
+    });
+  });
+
+  describe('.editMany', () => {
+    it('applies all of the edits to the tree and its existing nodes', () => {
+      let input = 'abc + cde + fgh';
+      let tree = parser.parse(input);
+      const sumNode = tree.rootNode.firstChild.firstChild;
+      const firstNode = sumNode.firstChild.firstChild;
+      const lastNode = sumNode.lastChild;
+
+      const edits = [];
+      let edit;
+      ([input, edit] = spliceInput(input, input.indexOf('fgh'), 0, 'x * '));
+      edits.push(edit);
+      ([input, edit] = spliceInput(input, input.indexOf('bc'), 0, ' * '));
+      edits.push(edit);
+      assert.equal(input, 'a * bc + cde + x * fgh');
+
+      assert.equal(tree.editMany(edits), tree);
+      assert.equal(firstNode.startIndex, 0);
+      assert.equal(firstNode.endIndex, 6);
+      assert.equal(lastNode.startIndex, input.indexOf('fgh'));
+      assert.equal(lastNode.endIndex, input.length);
+
+      const newTree = parser.parse(input, tree);
+      assert.equal(newTree.rootNode.toString(), parser.parse(input).rootNode.toString());
+    });
+
+    it('accepts edits packed into a Uint32Array', () => {
+      const tree = parser.parse('abc + cde');
+      const variableNode = tree.rootNode.firstChild.firstChild.lastChild;
+
+      // startRow, startColumn, oldEndRow, oldEndColumn, newEndRow,
+      // newEndColumn, startIndex, oldEndIndex, newEndIndex
+      tree.editMany(new Uint32Array([
+        0, 1, 0, 1, 0, 4, 1, 1, 4,
+        0, 10, 0, 10, 0, 12, 10, 10, 12,
+      ]));
+      assert.equal(variableNode.startIndex, 9);
+      assert.equal(variableNode.endIndex, 14);
+      assert.throws(() => tree.editMany(new Uint32Array(4)), /nine values per edit/);
+    });
   });
 
   describe('.getEditedRange()', () => {
@@ -305,6 +384,138 @@ describe("Tree", () => {
       assert(!cursor.gotoParent());
     })
   });
+
+  describe(".share() and Tree.fromShared()", () => {
+    it("recreates the tree from a shared handle", () => {
+      const input = 'abc + def(ghi)';
+      const tree = parser.parse(input);
+      const handle = tree.share();
+      assert.instanceOf(handle, SharedArrayBuffer);
+
+      const copy = Parser.Tree.fromShared(handle, JavaScript, input);
+      assert.notEqual(copy, tree);
+      assert.equal(copy.rootNode.toString(), tree.rootNode.toString());
+      assert.equal(copy.rootNode.descendantsOfType('identifier')[1].text, 'def');
+    });
+
+    it("is not affected by later edits to the original tree", () => {
+      const input = 'abc + def';
+      const tree = parser.parse(input);
+      const handle = tree.share();
+
+      const [newInput, edit] = spliceInput(input, 0, 3, 'x');
+      tree.edit(edit);
+      parser.parse(newInput, tree);
+
+      const copy = Parser.Tree.fromShared(handle, JavaScript, input);
+      assert.isFalse(copy.rootNode.hasChanges());
+      assert.equal(copy.rootNode.firstChild.firstChild.firstChild.text, 'abc');
+    });
+
+    it("throws when the handle did not come from a tree", () => {
+      assert.throws(() => Parser.Tree.fromShared(new SharedArrayBuffer(4), JavaScript), /must be a shared tree/);
+      assert.throws(() => Parser.Tree.fromShared({}, JavaScript), /must be a shared tree/);
+    });
+  });
+
+  describe("node objects", () => {
+    it("returns the same object for a node across calls", () => {
+      const tree = parser.parse('a(b, c);');
+      const callNode = tree.rootNode.firstChild.firstChild;
+      assert.strictEqual(tree.rootNode.firstChild.firstChild, callNode);
+      assert.strictEqual(callNode.firstChild.parent, callNode);
+      assert.strictEqual(tree.rootNode.descendantsOfType('call_expression')[0], callNode);
+    });
+
+    it("applies edits to nodes that are still held", () => {
+      let input = 'abc + cde';
+      const tree = parser.parse(input);
+      const variableNode = tree.rootNode.firstChild.firstChild.lastChild;
+      let edit;
+      ([input, edit] = spliceInput(input, 0, 0, 'xy'));
+      tree.edit(edit);
+
+      assert.equal(variableNode.startIndex, 8);
+      assert.strictEqual(tree.rootNode.firstChild.firstChild.lastChild, variableNode);
+      assert.equal(tree.rootNode.firstChild.firstChild.lastChild.startIndex, 8);
+    });
+
+    it("detaches the nodes handed out before releaseNodes", () => {
+      const tree = parser.parse('a(b, c);');
+      const callNode = tree.rootNode.firstChild.firstChild;
+      const argument = callNode.lastChild.firstNamedChild;
+      assert.equal(argument.text, 'b');
+
+      assert.equal(tree.releaseNodes(), tree);
+      assert.isNull(argument.parent);
+      assert.isNull(argument.nextSibling);
+
+      const newCallNode = tree.rootNode.firstChild.firstChild;
+      assert.notStrictEqual(newCallNode, callNode);
+      assert.equal(newCallNode.type, 'call_expression');
+      assert.strictEqual(tree.rootNode.firstChild.firstChild, newCallNode);
+      assert.equal(newCallNode.lastChild.firstNamedChild.text, 'b');
+    });
+  });
+
+  describe(".toFlatArrays()", () => {
+    it("returns the tree's nodes in preorder, as parallel typed arrays", () => {
+      const tree = parser.parse('a * b + c');
+      const nodes = [];
+      const visit = (node, parent) => {
+        const index = nodes.length;
+        nodes.push({node, parent});
+        for (const child of node.children) visit(child, index);
+      };
+      visit(tree.rootNode, -1);
+
+      const table = tree.toFlatArrays();
+      assert.equal(table.length, nodes.length);
+      assert.instanceOf(table.typeId, Uint16Array);
+      assert.instanceOf(table.parent, Int32Array);
+      assert.isUndefined(table.fieldId);
+      nodes.forEach(({node, parent}, i) => {
+        assert.equal(table.typeId[i], node.typeId);
+        assert.equal(table.startIndex[i], node.startIndex);
+        assert.equal(table.endIndex[i], node.endIndex);
+        assert.equal(table.startRow[i], node.startPosition.row);
+        assert.equal(table.startColumn[i], node.startPosition.column);
+        assert.equal(table.endRow[i], node.endPosition.row);
+        assert.equal(table.endColumn[i], node.endPosition.column);
+        assert.equal(table.parent[i], parent);
+        assert.equal(table.childCount[i], node.childCount);
+        assert.equal(Boolean(table.flags[i] & Parser.Tree.FlatNodeFlags.NAMED), node.isNamed);
+      });
+    });
+
+    it("can skip anonymous nodes and include field ids", () => {
+      const tree = parser.parse('a * b + c');
+      const table = tree.toFlatArrays({namedOnly: true, fields: true});
+      const namedNodes = [];
+      const visit = (node) => {
+        namedNodes.push(node);
+        for (const child of node.namedChildren) visit(child);
+      };
+      visit(tree.rootNode);
+
+      assert.equal(table.length, namedNodes.length);
+      assert.deepEqual(Array.from(table.typeId), namedNodes.map(node => node.typeId));
+      assert.deepEqual(Array.from(table.childCount), namedNodes.map(node => node.namedChildCount));
+      assert.equal(table.fieldId.length, table.length);
+
+      // `(a * b) + c`: the outer expression has no field, its operands do.
+      assert.equal(table.fieldId[2], 0);
+      assert.notEqual(table.fieldId[3], 0);
+      assert.notEqual(table.fieldId[6], 0);
+    });
+
+    it("reports errors and missing nodes in the flags column", () => {
+      const tree = parser.parse('a +');
+      const table = tree.toFlatArrays();
+      const {ERROR, MISSING} = Parser.Tree.FlatNodeFlags;
+      assert(table.flags.some(flags => flags & (ERROR | MISSING)));
+    });
+  });
 });
 
 function assertCursorState(cursor, params) {
@@ -1,10 +1,17 @@
 declare module "tree-sitter" {
   class Parser {
-    parse(input: string | Parser.Input | Parser.InputReader, oldTree?: Parser.Tree, options?: { bufferSize?: number, includedRanges?: Parser.Range[] }): Parser.Tree;
+    parse(input: string | Parser.Input | Parser.InputReader | ArrayBuffer | ArrayBufferView, oldTree?: Parser.Tree, options?: { bufferSize?: number, includedRanges?: Parser.Range[], encoding?: Parser.Encoding }): Parser.Tree;
+    parse(input: string | Parser.Input | Parser.InputReader | ArrayBuffer | ArrayBufferView, oldTree: Parser.Tree | null | undefined, options: { bufferSize?: number, includedRanges?: Parser.Range[], encoding?: Parser.Encoding, timeSliceMicros: number, signal?: AbortSignal }): Parser.Tree | Promise<Parser.Tree>;
+    parseAsync(input: string | ArrayBuffer | ArrayBufferView, oldTree?: Parser.Tree, options?: { includedRanges?: Parser.Range[], encoding?: Parser.Encoding, signal?: AbortSignal }): Promise<Parser.Tree>;
+    parseFile(path: string, options?: { encoding?: Parser.Encoding, includedRanges?: Parser.Range[], async?: false }): Parser.Tree;
+    parseFile(path: string, options: { encoding?: Parser.Encoding, includedRanges?: Parser.Range[], async: true, signal?: AbortSignal }): Promise<Parser.Tree>;
+    cancel(): void;
     parseTextBuffer(buffer: Parser.TextBuffer, oldTree?: Parser.Tree, options?: { syncTimeoutMicros?: number, includedRanges?: Parser.Range[] }): Parser.Tree | Promise<Parser.Tree>;
     parseTextBufferSync(buffer: Parser.TextBuffer, oldTree?: Parser.Tree, options?: { includedRanges?: Parser.Range[] }): Parser.Tree;
     getLanguage(): any;
     setLanguage(language: any): void;
+    getEncoding(): Parser.Encoding;
+    setEncoding(encoding: Parser.Encoding): Parser;
     getLogger(): Parser.Logger;
     setLogger(logFunc: Parser.Logger): void;
     printDotGraphs(enabled: boolean): void;
@@ -32,6 +39,8 @@ declare module "tree-sitter" {
       newEndPosition: Point;
     };
 
+    export type Encoding = "utf8" | "utf16";
+
     export type Logger = (
       message: string,
       params: {[param: string]: string},
@@ -41,7 +50,7 @@ declare module "tree-sitter" {
     export type TextBuffer = Buffer;
 
     export interface InputReader {
-      (index: any, position: Point): string;
+      (index: any, position: Point): string | Buffer;
     }
 
     export interface Input {
@@ -94,8 +103,25 @@ declare module "tree-sitter" {
 
       closest(types: String | Array<String>): SyntaxNode | null;
       walk(): TreeCursor;
+      traverse(options?: { types?: String | Array<String>, namedOnly?: boolean, maxDepth?: number, startIndex?: number, endIndex?: number }): TreeTraversal;
+      read(mask: number, out?: Uint32Array): Uint32Array;
     }
 
+    export const SyntaxNode: {
+      readonly ReadFields: {
+        readonly TYPE_ID: number,
+        readonly START_INDEX: number,
+        readonly END_INDEX: number,
+        readonly START_POSITION: number,
+        readonly END_POSITION: number,
+        readonly CHILD_COUNT: number,
+        readonly NAMED_CHILD_COUNT: number,
+        readonly FLAGS: number,
+      };
+      readMany(nodes: SyntaxNode[], mask: number, out?: Uint32Array): Uint32Array;
+      readSize(mask: number): number;
+    };
+
     export interface TreeCursor {
       nodeType: string;
       nodeText: string;
@@ -114,21 +140,68 @@ declare module "tree-sitter" {
       gotoNextSibling(): boolean;
     }
 
+    export class TreeTraversal implements Iterable<Uint32Array> {
+      static readonly EVENT_SIZE: number;
+      static readonly ENTER: number;
+      static readonly EXIT: number;
+
+      readonly tree: Tree;
+
+      next(chunkSize?: number): Uint32Array | null;
+      nodeAt(events: Uint32Array, offset: number): SyntaxNode;
+      [Symbol.iterator](): Iterator<Uint32Array>;
+    }
+
     export interface Tree {
       readonly rootNode: SyntaxNode;
+      readonly encoding: Encoding;
 
       edit(delta: Edit): Tree;
+      editMany(deltas: Edit[] | Uint32Array): Tree;
+      releaseNodes(): Tree;
       walk(): TreeCursor;
+      toFlatArrays(options?: { namedOnly?: boolean, fields?: boolean }): FlatTree;
+      share(): SharedArrayBuffer;
       getChangedRanges(other: Tree): Range[];
       getEditedRange(other: Tree): Range;
       printDotGraph(): void;
     }
 
+    export const Tree: {
+      fromShared(handle: SharedArrayBuffer, language: any, input?: string | ArrayBuffer | ArrayBufferView | InputReader): Tree;
+    };
+
+    export interface FlatTree {
+      length: number;
+      typeId: Uint16Array;
+      fieldId?: Uint16Array;
+      startIndex: Uint32Array;
+      endIndex: Uint32Array;
+      startRow: Uint32Array;
+      startColumn: Uint32Array;
+      endRow: Uint32Array;
+      endColumn: Uint32Array;
+      parent: Int32Array;
+      childCount: Uint32Array;
+      flags: Uint8Array;
+    }
+
     export interface QueryMatch {
       pattern: number,
       captures: QueryCapture[],
     }
 
+    export interface CompactMatches {
+      patterns: Uint32Array;
+      captureOffsets: Uint32Array;
+      captures: Uint32Array;
+      didExceedMatchLimit: boolean;
+    }
+
+    export interface QueryMatchIterator extends IterableIterator<QueryMatch> {
+      didExceedMatchLimit(): boolean;
+    }
+
     export interface QueryCapture {
       name: string,
       text?: string,
@@ -138,7 +211,20 @@ declare module "tree-sitter" {
       refutedProperties?: {[prop: string]: string | null},
     }
 
+    export class ParserPool {
+      readonly size: number;
+
+      constructor(size?: number);
+
+      getLanguage(): any;
+      setLanguage(language: any): ParserPool;
+      parseMany(inputs: (string | ArrayBuffer | ArrayBufferView)[], options?: { encoding?: Encoding, onTree?: (tree: Tree, index: number) => void }): Promise<Tree[]>;
+    }
+
     export class Query {
+      static readonly CAPTURE_SIZE: number;
+
+      readonly captureNames: string[];
       readonly predicates: { [name: string]: Function }[];
       readonly setProperties: any[];
       readonly assertedProperties: any[];
@@ -146,8 +232,12 @@ declare module "tree-sitter" {
 
       constructor(language: any, source: string | Buffer);
 
-      matches(rootNode: SyntaxNode, startPosition?: Point, endPosition?: Point): QueryMatch[];
-      captures(rootNode: SyntaxNode, startPosition?: Point, endPosition?: Point): QueryCapture[];
+      matches(rootNode: SyntaxNode, startPosition?: Point, endPosition?: Point, options?: { matchLimit?: number }): QueryMatch[];
+      iterMatches(rootNode: SyntaxNode, options?: { startPosition?: Point, endPosition?: Point, limit?: number, chunkSize?: number, matchLimit?: number }): QueryMatchIterator;
+      captures(rootNode: SyntaxNode, startPosition?: Point, endPosition?: Point, options?: { matchLimit?: number }): QueryCapture[];
+      capturesCompact(rootNode: SyntaxNode, startPosition?: Point, endPosition?: Point, options?: { matchLimit?: number }): Uint32Array;
+      matchesAsync(rootNode: SyntaxNode, startPosition?: Point, endPosition?: Point, options?: { matchLimit?: number }): Promise<CompactMatches>;
+      didExceedMatchLimit(): boolean;
     }
   }
 